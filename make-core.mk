@@ -94,6 +94,51 @@ install-static: $(AFILE) $(PCFILE)
 	install -m 644 $(AFILE) $(DESTDIR)$(LIBDIR)
 	install -m 644 $(PCFILE) $(DESTDIR)$(LIBDIR)/pkgconfig
 
+#
+# library variants: the library is built once more for every variant V
+# listed in VARIANTS with CFLAGS-V added, objects are placed into the
+# obj-V directory, the library is named libLIBNAME-V.a. CFLAGS-V may
+# change the library ABI, thus they are passed to users of the variant
+# with its own pkg-config file LIBNAME-V.pc
+#
+
+define variant
+$(1)-OBJECTS = $$(patsubst %.c,obj-$(1)/%.o, $$(SOURCES))
+$(1)-AFILE = lib$(LIBNAME)-$(1).a
+$(1)-PCFILE = $(LIBNAME)-$(1).pc
+
+obj-$(1)/%.o: %.c
+	@mkdir -p obj-$(1)
+	$$(CC) $$(CFLAGS) -I$$(CURDIR)/include $$(CFLAGS-$(1)) -c -o $$@ $$<
+
+$$($(1)-AFILE): $$($(1)-OBJECTS)
+
+$$($(1)-PCFILE):
+	@test -n "$$(DESCRIPTION)" && echo "Description: $$(DESCRIPTION) ($(1))" > $$@
+	@test -n "$$(URL)" && echo "URL: $$(URL)"		>> $$@
+	@echo "Name: $(LIBNAME)-$(1)"			>> $$@
+	@echo "Version: $$(LIBVER).$$(LIBREV)"		>> $$@
+ifneq ($$(DEPENDS),)
+	@echo "Requires: $$(DEPENDS)"			>> $$@
+endif
+	@echo "Libs: -l$(LIBNAME)-$(1)"			>> $$@
+	@echo "Cflags: -I$$(INCROOT) $$(CFLAGS-$(1))"	>> $$@
+
+build-static: $$($(1)-AFILE)
+
+install-static: install-static-$(1)
+install-static-$(1): $$($(1)-AFILE) $$($(1)-PCFILE)
+	install -d $$(DESTDIR)$$(LIBDIR)/pkgconfig
+	install -m 644 $$($(1)-AFILE) $$(DESTDIR)$$(LIBDIR)
+	install -m 644 $$($(1)-PCFILE) $$(DESTDIR)$$(LIBDIR)/pkgconfig
+
+clean-static: clean-static-$(1)
+clean-static-$(1):
+	$$(RM) -r obj-$(1) $$($(1)-AFILE) $$($(1)-PCFILE)
+endef
+
+$(foreach V,$(VARIANTS),$(eval $(call variant,$(V))))
+
 else  # not defined LIBNAME
 
 AFILE	= bundle.a
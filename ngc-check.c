@@ -37,12 +37,37 @@ static int ngc_g0000_check (struct ngc_state *o)
 	return ngc_motion_check (o, "G0");
 }
 
+/*
+ * The block is checked before it is executed, thus the feed rate mode
+ * set by the block itself is taken into account here.
+ */
+static int ngc_is_inv_block (struct ngc_state *o)
+{
+	return ngc_modal (o, NGC_G5) == NGC_G0930;
+}
+
+/*
+ * The feed rate of the block is the F word if any, otherwise the current
+ * one: there is no current rate in inverse time mode.
+ */
+static int ngc_rate_check (struct ngc_state *o, const char *cmd)
+{
+	double rate = (o->map & NGC_F) != 0 ? ngc_word (o, 'F') :
+		      ngc_is_inv_block (o) ? 0 : o->var[NGC_FEED];
+
+	if (rate <= 0)
+		return ngc_error (o, "Cannot do %s with zero feed rate", cmd);
+
+	return 1;
+}
+
 static int ngc_feed_check (struct ngc_state *o, const char *cmd)
 {
-	if (ngc_is_inv_mode (o) && (o->map & NGC_F) == 0)
+	if (ngc_is_inv_block (o) && (o->map & NGC_F) == 0)
 		return ngc_error (o, "No F word in inverse time feed rate "
 				     "mode for %s", cmd);
-	return 1;
+
+	return ngc_rate_check (o, cmd);
 }
 
 static int ngc_g0010_check (struct ngc_state *o)
@@ -152,6 +177,7 @@ static int ngc_int_check (struct ngc_state *o, char word, long lo, long hi,
 	return 1;
 }
 
+#if NGC_HAS_G10
 static int ngc_g0100_check (struct ngc_state *o)
 {
 	int L = ngc_word (o, 'L');
@@ -170,6 +196,7 @@ static int ngc_g0100_check (struct ngc_state *o)
 
 	return ngc_error (o, "Unknown command G10 L%d", L);
 }
+#endif
 
 static int ngc_g0170_check (struct ngc_state *o)
 {
@@ -219,9 +246,12 @@ static int ngc_g0382_check (struct ngc_state *o)
 	if ((o->map & NGC_XYZ) == 0)
 		return ngc_error (o, "No X, Y, or Z-axis word for G38.2");
 
-	if (ngc_is_inv_mode (o))
+	if (ngc_is_inv_block (o))
 		return ngc_error (o, "Cannot run G38.2 in inverse time feed "
 				     "rate mode");
+
+	if (!ngc_rate_check (o, "G38.2"))
+		return 0;
 	/*
 	 * The minimum movement and roration conditions are checked at
 	 * execution time.
@@ -234,6 +264,7 @@ static int ngc_g0400_check (struct ngc_state *o)
 	return 1;  /* No conditions to turn cutter radius compensation off */
 }
 
+#if NGC_HAS_COMP
 static int ngc_comp_check (struct ngc_state *o, const char *name)
 {
 	if (ngc_is_comp_mode (o))
@@ -262,6 +293,7 @@ static int ngc_g0420_check (struct ngc_state *o)
 	return ngc_comp_check (o, "Tool number for cutter radius "
 				  "compensation on right");
 }
+#endif
 
 static int ngc_g0430_check (struct ngc_state *o)
 {
@@ -369,8 +401,46 @@ static int ngc_g0800_check (struct ngc_state *o)
 	return 1;
 }
 
+#if NGC_HAS_CYCLES
+/*
+ * Distance mode may be changed in the same block
+ */
+static int ngc_is_rel_mode (struct ngc_state *o)
+{
+	if (o->g[NGC_G3] != 0)
+		return o->g[NGC_G3] == NGC_G0910;
+
+	return o->var[NGC_REL] != 0;
+}
+
+/*
+ * Canned cycle levels are sticky: use values from previous cycle if the
+ * words are not given
+ */
+static double ngc_cycle_level (struct ngc_state *o, int c)
+{
+	long mask = 1L << (c - 'A');
+
+	if ((o->map & mask) != 0)
+		return ngc_word (o, c);
+
+	return o->var[c == 'R' ? NGC_CYCLE_R : NGC_CYCLE_Z];
+}
+
+/*
+ * The cycle is the first one if the block motion differs from the
+ * current modal motion, the cycle level word is required then.
+ */
+static int ngc_is_first_cycle (struct ngc_state *o)
+{
+	return o->g[NGC_G1] != o->var[NGC_MODAL + NGC_G1];
+}
+
 static int ngc_canned_check (struct ngc_state *o, const char *cmd)
 {
+	/* in incremental mode the bottom level is given relative to R */
+	double r = ngc_is_rel_mode (o) ? 0 : ngc_cycle_level (o, 'R');
+
 	if ((o->map & NGC_XYZ) == 0)
 		return ngc_error (o, "No X, Y, or Z-axis word for %s", cmd);
 
@@ -380,38 +450,41 @@ static int ngc_canned_check (struct ngc_state *o, const char *cmd)
 
 	switch ((int) o->var[NGC_PLANE]) {
 	case NGC_PLANE_XY:
-		if ((o->map & NGC_Z) == 0 && o->g[NGC_G1] != o->prev->g[NGC_G1])
+		if ((o->map & NGC_Z) == 0 && ngc_is_first_cycle (o))
 			return ngc_error (o, "No Z word for first %s", cmd);
 
-		if (ngc_word (o, 'R') < ngc_word (o, 'Z'))
+		if (r < ngc_cycle_level (o, 'Z'))
 			return ngc_error (o, "R < Z for canned cycle in XY "
 					     "plane for %s", cmd);
 		break;
 	case NGC_PLANE_XZ:
-		if ((o->map & NGC_Y) == 0 && o->g[NGC_G1] != o->prev->g[NGC_G1])
+		if ((o->map & NGC_Y) == 0 && ngc_is_first_cycle (o))
 			return ngc_error (o, "No Y word for first %s", cmd);
 
-		if (ngc_word (o, 'R') < ngc_word (o, 'Y'))
+		if (r < ngc_cycle_level (o, 'Y'))
 			return ngc_error (o, "R < Y for canned cycle in XZ "
 					     "plane for %s", cmd);
 		break;
 	case NGC_PLANE_YZ:
-		if ((o->map & NGC_X) == 0 && o->g[NGC_G1] != o->prev->g[NGC_G1])
+		if ((o->map & NGC_X) == 0 && ngc_is_first_cycle (o))
 			return ngc_error (o, "No X word for first %s", cmd);
 
-		if (ngc_word (o, 'R') < ngc_word (o, 'X'))
+		if (r < ngc_cycle_level (o, 'X'))
 			return ngc_error (o, "R < X for canned cycle in YZ "
 					     "plane for %s", cmd);
 		break;
 	}
 
-	if (ngc_is_inv_mode (o))
+	if (ngc_is_inv_block (o))
 		return ngc_error (o, "Cannot run canned cycle in inverse time "
 				     "feed rate mode for %s", cmd);
 
 	if (ngc_is_comp_mode (o))
 		return ngc_error (o, "Cannot run canned cycle while cutter "
 				     "compensation is active for %s", cmd);
+
+	if (!ngc_rate_check (o, cmd))
+		return 0;
 	/*
 	 * TODO: The rotation axis movement is checked at execution time.
 	 */
@@ -452,7 +525,7 @@ static int ngc_g0860_check (struct ngc_state *o)
 
 static int ngc_g0870_check (struct ngc_state *o)
 {
-	return ngc_canned_check (o, "G87");
+	return ngc_error (o, "Canned cycle G87 is not supported");
 }
 
 static int ngc_g0880_check (struct ngc_state *o)
@@ -467,6 +540,8 @@ static int ngc_g0890_check (struct ngc_state *o)
 	       ngc_canned_check (o, "G89");
 }
 
+#endif
+
 static int ngc_g0900_check (struct ngc_state *o)
 {
 	return 1;  /* No conditions for absolute distance mode */
@@ -529,7 +604,9 @@ static int ngc_check_gcode (struct ngc_state *o, int gcode)
 	case NGC_G0020:	return ngc_g0020_check (o);
 	case NGC_G0030:	return ngc_g0030_check (o);
 	case NGC_G0040:	return ngc_g0040_check (o);
+#if NGC_HAS_G10
 	case NGC_G0100:	return ngc_g0100_check (o);
+#endif
 	case NGC_G0170:	return ngc_g0170_check (o);
 	case NGC_G0180:	return ngc_g0180_check (o);
 	case NGC_G0190:	return ngc_g0190_check (o);
@@ -539,8 +616,10 @@ static int ngc_check_gcode (struct ngc_state *o, int gcode)
 	case NGC_G0300:	return ngc_g0300_check (o);
 	case NGC_G0382:	return ngc_g0382_check (o);
 	case NGC_G0400:	return ngc_g0400_check (o);
+#if NGC_HAS_COMP
 	case NGC_G0410:	return ngc_g0410_check (o);
 	case NGC_G0420:	return ngc_g0420_check (o);
+#endif
 	case NGC_G0430:	return ngc_g0430_check (o);
 	case NGC_G0490:	return ngc_g0490_check (o);
 	case NGC_G0530:	return ngc_g0530_check (o);
@@ -557,6 +636,7 @@ static int ngc_check_gcode (struct ngc_state *o, int gcode)
 	case NGC_G0611:	return ngc_g0611_check (o);
 	case NGC_G0640:	return ngc_g0640_check (o);
 	case NGC_G0800:	return ngc_g0800_check (o);
+#if NGC_HAS_CYCLES
 	case NGC_G0810:	return ngc_g0810_check (o);
 	case NGC_G0820:	return ngc_g0820_check (o);
 	case NGC_G0830:	return ngc_g0830_check (o);
@@ -566,6 +646,7 @@ static int ngc_check_gcode (struct ngc_state *o, int gcode)
 	case NGC_G0870:	return ngc_g0870_check (o);
 	case NGC_G0880:	return ngc_g0880_check (o);
 	case NGC_G0890:	return ngc_g0890_check (o);
+#endif
 	case NGC_G0900:	return ngc_g0900_check (o);
 	case NGC_G0910:	return ngc_g0910_check (o);
 	case NGC_G0920:	return ngc_g0920_check (o);
@@ -0,0 +1,173 @@
+/*
+ * NIST RS274/NGC Block Dependencies
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ngc-state.h"
+
+unsigned ngc_var_class (int i)
+{
+	if (i >= NGC_PROBE_X && i <= NGC_PROBE_OK)
+		return NGC_VC_PROBE;
+
+	if (i >= NGC_HOME_X && i <= NGC_WORK_W)
+		return NGC_VC_HOME;
+
+	if (i >= NGC_OFFSET_ON && i <= NGC_CS9_R)
+		return NGC_VC_ORIGIN;
+
+	if (i == NGC_INPUT)
+		return NGC_VC_INPUT;
+
+	if (i >= NGC_TOOL && i <= NGC_TOOL_O)
+		return NGC_VC_TOOL;
+
+	return NGC_VC_USER;
+}
+
+static const char *ngc_scan_skip (const char *p)
+{
+	while (*p == ' ' || *p == '\t')
+		++p;
+
+	return p;
+}
+
+/*
+ * Parameter reference: literal index or any parameter if the index is
+ * a parameter value itself
+ */
+static const char *ngc_scan_ref (const char *p, unsigned *class)
+{
+	char *end;
+	long i;
+
+	if (*(p = ngc_scan_skip (p)) == '#') {
+		*class = NGC_VC_ALL;
+		return p;  /* the inner reference is scanned next */
+	}
+
+	i = strtol (p, &end, 10);
+	*class = end == p ? NGC_VC_ALL : ngc_var_class (i);
+
+	while (isdigit (*end) || *end == '.' || *end == ' ')
+		++end;
+
+	return end;
+}
+
+int ngc_scan (struct ngc_state *o, const char *line)
+{
+	struct ngc_deps *d = &o->deps;
+	const char *p;
+	unsigned class;
+
+	memset (d, 0, sizeof (*d));
+
+	for (p = line; (p = strpbrk (p, "#(;")) != NULL;)
+		switch (*p) {
+		case '(':
+			if ((p = strchr (p, ')')) == NULL)
+				return 1;  /* parser reports it */
+
+			++p;
+			break;
+		case ';':
+			return 1;
+		default:
+			p = ngc_scan_ref (p + 1, &class);
+
+			if (*p == '=')
+				d->writes |= class;
+			else
+				d->reads  |= class;
+		}
+
+	return 1;
+}
+
+/*
+ * Motion reads the current code of all groups motion depends on
+ */
+static const unsigned ngc_motion_groups =
+	1u << NGC_G1  | 1u << NGC_G2  | 1u << NGC_G3  | 1u << NGC_G5  |
+	1u << NGC_G6  | 1u << NGC_G7  | 1u << NGC_G8  | 1u << NGC_G10 |
+	1u << NGC_G12 | 1u << NGC_G13;
+
+/*
+ * Motion reads the current position of the axes not given in the block.
+ * Incremental, probe and cycle motions read all of them, and so do arcs
+ * (the center and radius depend on the start point) and inverse time
+ * motions (the duration is spread over the path length).
+ */
+int ngc_deps (struct ngc_state *o)
+{
+	struct ngc_deps *d = &o->deps;
+	int motion = ngc_modal (o, NGC_G1), i;
+	int whole = ngc_modal (o, NGC_G3) == NGC_G0910 ||
+		    ngc_modal (o, NGC_G5) == NGC_G0930 ||
+		    motion == NGC_G0020 || motion == NGC_G0030 ||
+		    motion == NGC_G0382 ||
+		    (motion >= NGC_G0810 && motion <= NGC_G0890);
+
+	for (i = 0; i < NGC_GSIZE; ++i)
+		if (i != NGC_G0 && i != NGC_M4 && o->g[i] != 0)
+			d->modal_writes |= 1u << i;
+
+	if (o->g[NGC_G8] == NGC_G0430)
+		d->reads |= NGC_VC_TOOL;
+
+	/* tool data is taken from the tool table */
+	if (o->ctx.tools != NULL &&
+	    ((o->g[NGC_G8] == NGC_G0430 && (o->map & NGC_H) != 0) ||
+	     (o->g[NGC_G7] == NGC_G0410 && (o->map & NGC_D) != 0) ||
+	     (o->g[NGC_G7] == NGC_G0420 && (o->map & NGC_D) != 0)))
+		d->writes |= NGC_VC_TOOL;
+
+	if (o->g[NGC_M6] != 0)
+		d->writes |= NGC_VC_TOOL;
+
+	if (o->g[NGC_G12] != 0)
+		d->writes |= NGC_VC_ORIGIN;
+
+	if (o->g[NGC_M4] == NGC_M0020 || o->g[NGC_M4] == NGC_M0300)
+		d->writes |= NGC_VC_ALL;  /* reset */
+
+	switch (o->g[NGC_G0]) {
+	case NGC_G0100: case NGC_G0921: case NGC_G0922: case NGC_G0923:
+		d->writes |= NGC_VC_ORIGIN;
+		return 1;
+
+	case NGC_G0920:
+		d->writes |= NGC_VC_ORIGIN;
+		d->axes   |= NGC_AXIS;
+		return 1;
+
+	case NGC_G0280: case NGC_G0300:
+		d->reads |= NGC_VC_HOME;
+		/* passthrough */
+	case NGC_G0530:
+		whole = 1;
+	}
+
+	if ((o->map & NGC_AXIS) == 0)
+		return 1;
+
+	d->reads	|= NGC_VC_ORIGIN | NGC_VC_POS;
+	d->writes	|= NGC_VC_POS;
+	d->axes		|= whole ? NGC_AXIS : NGC_AXIS & ~o->map;
+	d->modal_reads	|= ngc_motion_groups & ~d->modal_writes;
+
+	if (motion == NGC_G0382)
+		d->writes |= NGC_VC_PROBE;
+
+	return 1;
+}
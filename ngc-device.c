@@ -0,0 +1,198 @@
+/*
+ * NIST RS274/NGC Device
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "ngc-driver.h"
+
+static const struct ngc_driver *ngc_drivers[] = {
+	&ngc_sim_driver,
+	&ngc_record_driver,
+	&ngc_events_driver,
+};
+
+/*
+ * 4.3.2 Initialization and Termination
+ *
+ * The device name has form "driver" or "driver:argument".
+ */
+struct ngc_device *ngc_device_alloc (const char *name)
+{
+	const size_t count = sizeof (ngc_drivers) / sizeof (ngc_drivers[0]);
+	size_t i, len = strcspn (name, ":");
+	const char *arg = name[len] == ':' ? name + len + 1 : NULL;
+	const struct ngc_driver *d;
+
+	for (i = 0; i < count; ++i) {
+		d = ngc_drivers[i];
+
+		if (strncmp (d->name, name, len) == 0 && d->name[len] == '\0')
+			return d->alloc (arg);
+	}
+
+	errno = ENOENT;
+	return NULL;
+}
+
+void ngc_device_free (struct ngc_device *o)
+{
+	if (o != NULL)
+		o->driver->free (o);
+}
+
+/*
+ * 4.3.10 Program Functions
+ */
+int ngc_device_reset (struct ngc_device *o)
+{
+	return o->driver->reset == NULL || o->driver->reset (o);
+}
+
+int ngc_device_block (struct ngc_device *o, long line)
+{
+	return o->driver->block == NULL || o->driver->block (o, line);
+}
+
+/*
+ * 4.3.3  Representation
+ * 4.3.5  Machining Attributes
+ */
+int ngc_device_mode (struct ngc_device *o, int opt, int value)
+{
+	return o->driver->mode == NULL || o->driver->mode (o, opt, value);
+}
+
+int ngc_device_conf (struct ngc_device *o, int opt, double value)
+{
+	return o->driver->conf == NULL || o->driver->conf (o, opt, value);
+}
+
+int ngc_device_offset (struct ngc_device *o, double *vec)
+{
+	return o->driver->offset == NULL || o->driver->offset (o, vec);
+}
+
+/*
+ * 4.3.4 Free Space Motion
+ */
+int ngc_device_home (struct ngc_device *o, int index)
+{
+	return o->driver->home == NULL || o->driver->home (o, index);
+}
+
+int ngc_device_move (struct ngc_device *o, int abs, double *end)
+{
+	return o->driver->move == NULL || o->driver->move (o, abs, end);
+}
+
+/*
+ * 4.3.6 Machining Functions
+ */
+int ngc_device_line (struct ngc_device *o, int abs, double *end)
+{
+	return o->driver->line == NULL || o->driver->line (o, abs, end);
+}
+
+int ngc_device_carc (struct ngc_device *o, double *end, double *c, int cw)
+{
+	return o->driver->carc == NULL || o->driver->carc (o, end, c, cw);
+}
+
+int ngc_device_rarc (struct ngc_device *o, double *end, double r, int cw)
+{
+	return o->driver->rarc == NULL || o->driver->rarc (o, end, r, cw);
+}
+
+int ngc_device_dwell (struct ngc_device *o, double delay)
+{
+	return o->driver->dwell == NULL || o->driver->dwell (o, delay);
+}
+
+int ngc_device_probe (struct ngc_device *o, double *end)
+{
+	return o->driver->probe == NULL ? 1 : o->driver->probe (o, end);
+}
+
+int ngc_device_stop (struct ngc_device *o, int opt)
+{
+	return o->driver->stop == NULL || o->driver->stop (o, opt);
+}
+
+/*
+ * 4.3.7 Spindle Functions
+ */
+int ngc_device_spindle (struct ngc_device *o, int op, double arg)
+{
+	return o->driver->spindle == NULL || o->driver->spindle (o, op, arg);
+}
+
+/*
+ * 4.3.8 Tool Functions
+ */
+int ngc_device_tool (struct ngc_device *o, int op, int slot)
+{
+	return o->driver->tool == NULL ? 1 : o->driver->tool (o, op, slot);
+}
+
+/*
+ * 4.3.11 Cutter Radius Compensation
+ */
+int ngc_device_cutter (struct ngc_device *o, int op, int slot)
+{
+	return o->driver->cutter == NULL || o->driver->cutter (o, op, slot);
+}
+
+/*
+ * 4.3.9 Miscellaneous Functions
+ */
+int ngc_device_comment (struct ngc_device *o, const char *s)
+{
+	return o->driver->comment == NULL || o->driver->comment (o, s);
+}
+
+int ngc_device_message (struct ngc_device *o, const char *s)
+{
+	return o->driver->message == NULL || o->driver->message (o, s);
+}
+
+int ngc_device_opt (struct ngc_device *o, int mask, int on)
+{
+	return o->driver->opt == NULL || o->driver->opt (o, mask, on);
+}
+
+int ngc_device_coolant (struct ngc_device *o, int mask, int on)
+{
+	return o->driver->coolant == NULL || o->driver->coolant (o, mask, on);
+}
+
+int ngc_device_pallet_shuttle (struct ngc_device *o)
+{
+	return o->driver->pallet_shuttle == NULL ||
+	       o->driver->pallet_shuttle (o);
+}
+
+int ngc_device_poll (struct ngc_device *o, struct ngc_result *r, int wait)
+{
+	return o->driver->poll != NULL && o->driver->poll (o, r, wait);
+}
+
+size_t ngc_device_save (struct ngc_device *o, void *buf, size_t size)
+{
+	return o->driver->save == NULL ? 0 : o->driver->save (o, buf, size);
+}
+
+int ngc_device_load (struct ngc_device *o, const void *buf, size_t size)
+{
+	if (o->driver->load == NULL)
+		return size == 0;
+
+	return o->driver->load (o, buf, size);
+}
@@ -10,6 +10,14 @@
 #ifndef NGC_DEVICE_H
 #define NGC_DEVICE_H  1
 
+#include <stddef.h>
+
+/*
+ * Axis vectors are ordered as in parameter blocks: X, Y, Z, A, B, C,
+ * U, V, W
+ */
+#define NGC_AXES  9
+
 /*
  * 4.3.2 Initialization and Termination
  */
@@ -23,6 +31,12 @@ void ngc_device_free (struct ngc_device *o);
 
 int ngc_device_reset	(struct ngc_device *o);
 
+/*
+ * Block marker: called before every block is executed with the source
+ * line number of the block
+ */
+int ngc_device_block	(struct ngc_device *o, long line);
+
 /*
  * 4.3.3  Representation
  * 4.3.5  Machining Attributes
@@ -102,12 +116,17 @@ int ngc_device_spindle	(struct ngc_device *o, int op, double arg);
 
 /*
  * 4.3.8 Tool Functions
+ *
+ * NGC_TOOL_COMP is informational: it reports the slot whose length offset
+ * is in effect (-1 for none) for devices recording tool usage. The offset
+ * is already included in the origin of all positions passed to the
+ * device, thus devices must not apply it again.
  */
 
 enum ngc_tool {
 	NGC_TOOL_SELECT,
 	NGC_TOOL_CHANGE,
-	NGC_TOOL_COMP,		/* Enable tool length compensation	*/
+	NGC_TOOL_COMP,		/* Tool length offset in effect		*/
 };
 
 int ngc_device_tool	(struct ngc_device *o, int op, int slot);
@@ -150,4 +169,39 @@ int ngc_device_coolant		(struct ngc_device *o, int mask, int on);
 
 int ngc_device_pallet_shuttle	(struct ngc_device *o);
 
+/*
+ * Operations with results (probe and tool change) may complete
+ * asynchronously: then the device method returns NGC_PENDING and the
+ * result is fetched later with poll. Devices completing such operations
+ * synchronously return the result with poll right after the call, or do
+ * not implement poll at all: probe trips at the end point then.
+ *
+ * The probe trip point is given in absolute program coordinates (or in
+ * machine coordinates if the device uses them). The poll function
+ * returns non-zero if the result is fetched, it blocks until one is
+ * available if wait is set.
+ */
+#define NGC_PENDING  2
+
+enum ngc_op {
+	NGC_OP_PROBE	= 1 << 0,
+	NGC_OP_TOOL	= 1 << 1,
+};
+
+struct ngc_result {
+	int op;			/* completed operation		*/
+	int ok;			/* probe tripped, tool changed	*/
+	double pos[NGC_AXES];	/* probe trip point		*/
+};
+
+int ngc_device_poll (struct ngc_device *o, struct ngc_result *r, int wait);
+
+/*
+ * Device state snapshot: save returns the state size and copies the
+ * state only if the buffer is large enough. Stateless devices have
+ * empty state.
+ */
+size_t ngc_device_save (struct ngc_device *o, void *buf, size_t size);
+int    ngc_device_load (struct ngc_device *o, const void *buf, size_t size);
+
 #endif  /* NGC_DEVICE_H */
@@ -0,0 +1,68 @@
+/*
+ * NIST RS274/NGC Device Driver Interface
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_DRIVER_H
+#define NGC_DRIVER_H  1
+
+#include "ngc-device.h"
+
+/*
+ * Every device starts with a pointer to its driver. Driver methods
+ * set to NULL are treated as always successful no-ops.
+ */
+struct ngc_device {
+	const struct ngc_driver *driver;
+};
+
+struct ngc_driver {
+	const char *name;
+
+	struct ngc_device *(*alloc) (const char *arg);
+	void (*free) (struct ngc_device *o);
+
+	int (*reset)	(struct ngc_device *o);
+	int (*block)	(struct ngc_device *o, long line);
+
+	int (*mode)	(struct ngc_device *o, int opt, int value);
+	int (*conf)	(struct ngc_device *o, int opt, double value);
+	int (*offset)	(struct ngc_device *o, double *vec);
+
+	int (*home)	(struct ngc_device *o, int index);
+	int (*move)	(struct ngc_device *o, int abs, double *end);
+
+	int (*line)	(struct ngc_device *o, int abs, double *end);
+	int (*carc)	(struct ngc_device *o, double *end, double *c, int cw);
+	int (*rarc)	(struct ngc_device *o, double *end, double r,  int cw);
+	int (*dwell)	(struct ngc_device *o, double delay);
+	int (*probe)	(struct ngc_device *o, double *end);
+	int (*stop)	(struct ngc_device *o, int opt);
+
+	int (*spindle)	(struct ngc_device *o, int op, double arg);
+	int (*tool)	(struct ngc_device *o, int op, int slot);
+	int (*cutter)	(struct ngc_device *o, int op, int slot);
+
+	int (*comment)	(struct ngc_device *o, const char *s);
+	int (*message)	(struct ngc_device *o, const char *s);
+
+	int (*opt)	(struct ngc_device *o, int mask, int on);
+	int (*coolant)	(struct ngc_device *o, int mask, int on);
+
+	int (*pallet_shuttle) (struct ngc_device *o);
+
+	int (*poll)	(struct ngc_device *o, struct ngc_result *r, int wait);
+
+	size_t (*save)	(struct ngc_device *o, void *buf, size_t size);
+	int    (*load)	(struct ngc_device *o, const void *buf, size_t size);
+};
+
+extern const struct ngc_driver ngc_sim_driver;
+extern const struct ngc_driver ngc_record_driver;
+extern const struct ngc_driver ngc_events_driver;
+
+#endif  /* NGC_DRIVER_H */
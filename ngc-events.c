@@ -0,0 +1,184 @@
+/*
+ * NIST RS274/NGC Machine Events Device
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+
+#include "ngc-driver.h"
+#include "ngc-events.h"
+
+struct ngc_events {
+	struct ngc_device device;
+
+	double time;			/* seconds from the program start */
+	long line;			/* current block line number	*/
+	int spindle, coolant;		/* spindle direction and coolants */
+	double speed;
+
+	struct ngc_event *event;
+	size_t count, avail;
+};
+
+static struct ngc_events *ngc_events (struct ngc_device *o)
+{
+	return (struct ngc_events *) o;
+}
+
+static int ngc_events_post (struct ngc_events *o, int type, int op, double arg)
+{
+	struct ngc_event *e;
+	size_t avail;
+
+	if (o->count == o->avail) {
+		avail = o->avail == 0 ? 64 : o->avail * 2;
+
+		if ((e = realloc (o->event, avail * sizeof (e[0]))) == NULL)
+			return 0;
+
+		o->event = e;
+		o->avail = avail;
+	}
+
+	e = o->event + o->count++;
+	e->time = o->time;
+	e->line = o->line;
+	e->type = type;
+	e->op   = op;
+	e->arg  = arg;
+	return 1;
+}
+
+static struct ngc_device *ngc_events_alloc (const char *arg)
+{
+	struct ngc_events *o;
+
+	if ((o = calloc (1, sizeof (*o))) == NULL)
+		return NULL;
+
+	o->device.driver = &ngc_events_driver;
+	return &o->device;
+}
+
+static void ngc_events_free (struct ngc_device *dev)
+{
+	free (ngc_events (dev)->event);
+	free (dev);
+}
+
+static int ngc_events_reset (struct ngc_device *dev)
+{
+	struct ngc_events *o = ngc_events (dev);
+
+	o->spindle = NGC_SPINDLE_STOP;
+	o->coolant = 0;
+	return ngc_events_post (o, NGC_EVENT_END, 0, 0);
+}
+
+static int ngc_events_block (struct ngc_device *dev, long line)
+{
+	ngc_events (dev)->line = line;
+	return 1;
+}
+
+static int ngc_events_is_running (int op)
+{
+	return op == NGC_SPINDLE_CW || op == NGC_SPINDLE_CCW;
+}
+
+static int ngc_events_conf (struct ngc_device *dev, int opt, double value)
+{
+	struct ngc_events *o = ngc_events (dev);
+
+	if (opt != NGC_CONF_SPEED || value == o->speed)
+		return 1;
+
+	o->speed = value;
+
+	return !ngc_events_is_running (o->spindle) ||
+	       ngc_events_post (o, NGC_EVENT_SPINDLE, o->spindle, value);
+}
+
+static int ngc_events_dwell (struct ngc_device *dev, double delay)
+{
+	ngc_events (dev)->time += delay;
+	return 1;
+}
+
+static int ngc_events_stop (struct ngc_device *dev, int opt)
+{
+	return ngc_events_post (ngc_events (dev), NGC_EVENT_STOP, opt, 0);
+}
+
+static int ngc_events_spindle (struct ngc_device *dev, int op, double arg)
+{
+	struct ngc_events *o = ngc_events (dev);
+
+	if (!ngc_events_is_running (op))
+		arg = 0;
+
+	if (op == o->spindle && (arg == 0 || arg == o->speed))
+		return 1;
+
+	o->spindle = op;
+
+	if (arg != 0)
+		o->speed = arg;
+
+	return ngc_events_post (o, NGC_EVENT_SPINDLE, op, arg);
+}
+
+static int ngc_events_tool (struct ngc_device *dev, int op, int slot)
+{
+	if (op == NGC_TOOL_COMP)
+		return 1;
+
+	return ngc_events_post (ngc_events (dev), NGC_EVENT_TOOL, op, slot);
+}
+
+static int ngc_events_coolant (struct ngc_device *dev, int mask, int on)
+{
+	struct ngc_events *o = ngc_events (dev);
+	int next = on ? o->coolant | mask : o->coolant & ~mask;
+
+	if (next == o->coolant)
+		return 1;
+
+	o->coolant = next;
+	return ngc_events_post (o, NGC_EVENT_COOLANT, next, 0);
+}
+
+static int ngc_events_pallet_shuttle (struct ngc_device *dev)
+{
+	return ngc_events_post (ngc_events (dev), NGC_EVENT_PALLET, 0, 0);
+}
+
+const struct ngc_driver ngc_events_driver = {
+	.name		= "events",
+	.alloc		= ngc_events_alloc,
+	.free		= ngc_events_free,
+	.reset		= ngc_events_reset,
+	.block		= ngc_events_block,
+	.conf		= ngc_events_conf,
+	.dwell		= ngc_events_dwell,
+	.stop		= ngc_events_stop,
+	.spindle	= ngc_events_spindle,
+	.tool		= ngc_events_tool,
+	.coolant	= ngc_events_coolant,
+	.pallet_shuttle	= ngc_events_pallet_shuttle,
+};
+
+int ngc_events_timeline (struct ngc_device *o, struct ngc_timeline *t)
+{
+	if (o->driver != &ngc_events_driver)
+		return 0;
+
+	t->event = ngc_events (o)->event;
+	t->count = ngc_events (o)->count;
+	t->time  = ngc_events (o)->time;
+	return 1;
+}
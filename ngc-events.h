@@ -0,0 +1,51 @@
+/*
+ * NIST RS274/NGC Machine Events Device
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_EVENTS_H
+#define NGC_EVENTS_H  1
+
+#include <stddef.h>
+
+#include "ngc-device.h"
+
+/*
+ * The "events" device keeps the time line of discrete machine events
+ * and ignores motions: the clock is advanced by dwells only. Thus the
+ * device is run with motions replaced by dwells (see NGC_NO_MOTION and
+ * NGC_RAPID) to get estimated timestamps without motion dispatch.
+ *
+ * Spindle events are posted when the direction or the speed of running
+ * spindle changes, coolant events when the set of active coolants (op)
+ * changes. Program end (M2, M30) stops spindle and coolant.
+ */
+enum ngc_event_type {
+	NGC_EVENT_TOOL,		/* op is tool select or change, arg is slot */
+	NGC_EVENT_SPINDLE,	/* op is spindle direction, arg is speed */
+	NGC_EVENT_COOLANT,	/* op is coolant mask			*/
+	NGC_EVENT_STOP,		/* op is set for optional stop (M1)	*/
+	NGC_EVENT_PALLET,	/* pallet shuttle			*/
+	NGC_EVENT_END,		/* program end				*/
+};
+
+struct ngc_event {
+	double time;		/* seconds from the program start	*/
+	long line;		/* block line number			*/
+	int type, op;
+	double arg;
+};
+
+struct ngc_timeline {
+	const struct ngc_event *event;
+	size_t count;
+	double time;		/* total time, seconds			*/
+};
+
+int ngc_events_timeline (struct ngc_device *o, struct ngc_timeline *t);
+
+#endif  /* NGC_EVENTS_H */
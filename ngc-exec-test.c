@@ -0,0 +1,1498 @@
+/*
+ * NIST RS274/NGC Executor Regression Test
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Every program of the corpus directory (tests by default) is executed
+ * into the recording device and the trace is compared with the golden
+ * one (name.trace), the first divergent block is reported. With -u
+ * golden traces are updated instead. Interpreter options of a program are
+ * given in its leading comment, see options below.
+ *
+ * Then focused checks run parts the corpus does not reach: asynchronous
+ * probe completion, parameter files, tool table reload, scrubbing, the
+ * segment index, stock removal, event time line, dependency sets, the
+ * command queue, the comment channel, the packer (run from the directory
+ * of the test) and the result cache. Scratch files are made in the
+ * corpus directory.
+ *
+ * Throughput depends on the host, thus baselines are not part of the
+ * corpus and the throughput check is opt-in: with -r throughput of every
+ * program is measured with the simulation device and compared with the
+ * baseline (name.rate), a missing baseline is a failure. With -R the
+ * baselines of this host are recorded instead.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ngc-driver.h"
+#include "ngc-events.h"
+#include "ngc-hash.h"
+#include "ngc-notes.h"
+#include "ngc-param.h"
+#include "ngc-queue.h"
+#include "ngc-record.h"
+#include "ngc-scrub.h"
+#include "ngc-sim.h"
+#include "ngc-state.h"
+#include "ngc-stock.h"
+
+#define ROUNDS		5	/* throughput measurement rounds	*/
+#define ROUND_TIME	0.05	/* minimal round time, seconds		*/
+
+static int update;		/* record golden traces		*/
+static int rates;		/* 1 check, 2 record baselines	*/
+static double threshold = 20;	/* allowed throughput loss, percents */
+
+/*
+ * Dump device: prints device calls as text lines to explain divergence
+ */
+struct dump {
+	struct ngc_device device;
+	FILE *out;
+	long line;
+};
+
+static FILE *out (struct ngc_device *o)
+{
+	return ((struct dump *) o)->out;
+}
+
+static void put_vec (FILE *to, const double *v, int count)
+{
+	int i;
+
+	for (i = 0; i < count; ++i)
+		fprintf (to, "%s%.17g", i > 0 ? "," : " ", v[i]);
+
+	fputc ('\n', to);
+}
+
+static int dump_reset (struct ngc_device *o)
+{
+	return fprintf (out (o), "reset\n") > 0;
+}
+
+static int dump_block (struct ngc_device *o, long line)
+{
+	((struct dump *) o)->line = line;
+	return fprintf (out (o), "block %ld\n", line) > 0;
+}
+
+static int dump_mode (struct ngc_device *o, int opt, int value)
+{
+	return fprintf (out (o), "mode %d %d\n", opt, value) > 0;
+}
+
+static int dump_conf (struct ngc_device *o, int opt, double value)
+{
+	return fprintf (out (o), "conf %d %.17g\n", opt, value) > 0;
+}
+
+static int dump_offset (struct ngc_device *o, double *vec)
+{
+	fprintf (out (o), "offset");
+	put_vec (out (o), vec, NGC_AXES);
+	return 1;
+}
+
+static int dump_home (struct ngc_device *o, int index)
+{
+	return fprintf (out (o), "home %d\n", index) > 0;
+}
+
+static int dump_move (struct ngc_device *o, int abs, double *end)
+{
+	fprintf (out (o), "move %d", abs);
+	put_vec (out (o), end, NGC_AXES);
+	return 1;
+}
+
+static int dump_line (struct ngc_device *o, int abs, double *end)
+{
+	fprintf (out (o), "line %d", abs);
+	put_vec (out (o), end, NGC_AXES);
+	return 1;
+}
+
+static int dump_carc (struct ngc_device *o, double *end, double *c, int cw)
+{
+	fprintf (out (o), "carc %d %.17g,%.17g,%.17g", cw, c[0], c[1], c[2]);
+	put_vec (out (o), end, NGC_AXES);
+	return 1;
+}
+
+static int dump_rarc (struct ngc_device *o, double *end, double r, int cw)
+{
+	fprintf (out (o), "rarc %d %.17g", cw, r);
+	put_vec (out (o), end, NGC_AXES);
+	return 1;
+}
+
+static int dump_dwell (struct ngc_device *o, double delay)
+{
+	return fprintf (out (o), "dwell %.17g\n", delay) > 0;
+}
+
+static int dump_probe (struct ngc_device *o, double *end)
+{
+	fprintf (out (o), "probe");
+	put_vec (out (o), end, NGC_AXES);
+	return 1;
+}
+
+static int dump_stop (struct ngc_device *o, int opt)
+{
+	return fprintf (out (o), "stop %d\n", opt) > 0;
+}
+
+static int dump_spindle (struct ngc_device *o, int op, double arg)
+{
+	return fprintf (out (o), "spindle %d %.17g\n", op, arg) > 0;
+}
+
+static int dump_tool (struct ngc_device *o, int op, int slot)
+{
+	return fprintf (out (o), "tool %d %d\n", op, slot) > 0;
+}
+
+static int dump_cutter (struct ngc_device *o, int op, int slot)
+{
+	return fprintf (out (o), "cutter %d %d\n", op, slot) > 0;
+}
+
+static int dump_comment (struct ngc_device *o, const char *s)
+{
+	return fprintf (out (o), "comment %s\n", s) > 0;
+}
+
+static int dump_message (struct ngc_device *o, const char *s)
+{
+	return fprintf (out (o), "message %s\n", s) > 0;
+}
+
+static int dump_opt (struct ngc_device *o, int mask, int on)
+{
+	return fprintf (out (o), "opt %d %d\n", mask, on) > 0;
+}
+
+static int dump_coolant (struct ngc_device *o, int mask, int on)
+{
+	return fprintf (out (o), "coolant %d %d\n", mask, on) > 0;
+}
+
+static int dump_pallet_shuttle (struct ngc_device *o)
+{
+	return fprintf (out (o), "pallet-shuttle\n") > 0;
+}
+
+static const struct ngc_driver dump_driver = {
+	.name		= "dump",
+	.reset		= dump_reset,
+	.block		= dump_block,
+	.mode		= dump_mode,
+	.conf		= dump_conf,
+	.offset		= dump_offset,
+	.home		= dump_home,
+	.move		= dump_move,
+	.line		= dump_line,
+	.carc		= dump_carc,
+	.rarc		= dump_rarc,
+	.dwell		= dump_dwell,
+	.probe		= dump_probe,
+	.stop		= dump_stop,
+	.spindle	= dump_spindle,
+	.tool		= dump_tool,
+	.cutter		= dump_cutter,
+	.comment	= dump_comment,
+	.message	= dump_message,
+	.opt		= dump_opt,
+	.coolant	= dump_coolant,
+	.pallet_shuttle	= dump_pallet_shuttle,
+};
+
+/*
+ * Load whole file into memory, returns NULL on error
+ */
+static char *load (const char *path, size_t *size)
+{
+	struct stat st;
+	char *data;
+	int fd;
+
+	if ((fd = open (path, O_RDONLY)) == -1)
+		return NULL;
+
+	if (fstat (fd, &st) != 0 || (data = malloc (st.st_size + 1)) == NULL)
+		goto no_data;
+
+	if (read (fd, data, st.st_size) != st.st_size)
+		goto no_read;
+
+	close (fd);
+	data[st.st_size] = '\0';
+	*size = st.st_size;
+	return data;
+no_read:
+	free (data);
+no_data:
+	close (fd);
+	return NULL;
+}
+
+static char *trace_text (const char *trace, size_t size, size_t *len)
+{
+	struct dump d = { .device.driver = &dump_driver };
+	char *text = NULL;
+
+	if ((d.out = open_memstream (&text, len)) == NULL)
+		return NULL;
+
+	ngc_record_play (trace, size, &d.device);
+	fclose (d.out);
+	return text;
+}
+
+/*
+ * Print the first divergent block: the block markers are dumped as well
+ * thus the last marker before the first different line is the block.
+ */
+static void diverge (const char *name, const char *want, size_t wlen,
+		     const char *got, size_t glen)
+{
+	char *a = trace_text (want, wlen, &wlen);
+	char *b = trace_text (got,  glen, &glen);
+	const char *p, *q, *block = "start";
+	size_t n, m;
+
+	if (a == NULL || b == NULL)
+		goto out;
+
+	for (p = a, q = b; *p != '\0' || *q != '\0'; p += n + 1, q += m + 1) {
+		n = strcspn (p, "\n");
+		m = strcspn (q, "\n");
+
+		if (n != m || memcmp (p, q, n) != 0) {
+			printf ("%s: diverges at %.*s\n"
+				"\texpected: %.*s\n\tgot:      %.*s\n", name,
+				(int) strcspn (block, "\n"), block,
+				(int) n, *p != '\0' ? p : "end of trace",
+				(int) m, *q != '\0' ? q : "end of trace");
+			break;
+		}
+
+		if (strncmp (p, "block ", 6) == 0)
+			block = p;
+
+		if (p[n] == '\0' || q[m] == '\0')
+			break;
+	}
+out:
+	free (a);
+	free (b);
+}
+
+/*
+ * Program options are listed in the leading comment of the program:
+ *
+ *	(exec: metric machine)
+ *
+ * metric: lengths of inch programs are normalised to millimeters;
+ * machine: the device gets end points in machine coordinates.
+ */
+static void options (const char *text, double *var)
+{
+	char line[128];
+
+	snprintf (line, sizeof (line), "%.*s", (int) strcspn (text, ")\n"),
+		  text);
+
+	if (strncmp (line, "(exec:", 6) != 0)
+		return;
+
+	var[NGC_METRIC]  = strstr (line, " metric")  != NULL;
+	var[NGC_MACHINE] = strstr (line, " machine") != NULL;
+}
+
+static int run (const char *text, size_t size, const char *device)
+{
+	struct ngc_state s = {};
+	struct ngc_device *dev;
+	FILE *in;
+	int ok = 0;
+
+	if ((s.var = calloc (NGC_VSIZE, sizeof (s.var[0]))) == NULL)
+		return 0;
+
+	if ((dev = ngc_device_alloc (device)) == NULL)
+		goto no_dev;
+
+	if ((in = fmemopen ((void *) text, size, "r")) == NULL)
+		goto no_in;
+
+	if (ngc_state_reset (&s)) {
+		options (text, s.var);
+		ok = ngc_run (&s, in, dev);
+	}
+
+	fclose (in);
+no_in:
+	ngc_device_free (dev);
+no_dev:
+	free (s.var);
+	return ok;
+}
+
+static double now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int check_trace (const char *name, const char *text, size_t size)
+{
+	char out[512], gold[512], *want, *got;
+	size_t wlen, glen;
+	int ok = 0;
+
+	snprintf (out,  sizeof (out),  "record:%s.out", name);
+	snprintf (gold, sizeof (gold), "%s.trace", name);
+
+	if (!run (text, size, out)) {
+		printf ("%s: execution failed\n", name);
+		return 0;
+	}
+
+	if (update)
+		return rename (out + 7, gold) == 0;
+
+	if ((want = load (gold, &wlen)) == NULL) {
+		printf ("%s: no golden trace: %s\n", name, strerror (errno));
+		return 0;
+	}
+
+	if ((got = load (out + 7, &glen)) == NULL)
+		goto no_got;
+
+	if (wlen == glen && memcmp (want, got, wlen) == 0) {
+		unlink (out + 7);
+		ok = 1;
+	}
+	else
+		diverge (name, want, wlen, got, glen);
+
+	free (got);
+no_got:
+	free (want);
+	return ok;
+}
+
+/*
+ * Throughput in blocks per second: the best of rounds to filter out
+ * scheduling noise, returns zero on execution failure
+ */
+static double measure (const char *text, size_t size)
+{
+	double start, time, rate, best = 0;
+	long blocks, lines = 0, i;
+	int round;
+
+	for (i = 0; i < (long) size; ++i)
+		lines += text[i] == '\n';
+
+	for (round = 0; round < ROUNDS; ++round) {
+		blocks = 0;
+		start  = now ();
+
+		do {
+			if (!run (text, size, "sim"))
+				return 0;
+
+			blocks += lines;
+		}
+		while ((time = now () - start) < ROUND_TIME);
+
+		if ((rate = blocks / time) > best)
+			best = rate;
+	}
+
+	return best;
+}
+
+static int check_rate (const char *name, const char *text, size_t size)
+{
+	double rate = measure (text, size), base;
+	char path[512];
+	FILE *f;
+	int ok = 1;
+
+	if (rate == 0)
+		return 0;
+
+	snprintf (path, sizeof (path), "%s.rate", name);
+
+	if (rates > 1) {
+		if ((f = fopen (path, "w")) == NULL)
+			return 0;
+
+		fprintf (f, "%.0f\n", rate);
+		return fclose (f) == 0;
+	}
+
+	if ((f = fopen (path, "r")) == NULL) {
+		printf ("%s: %.0f blocks/s, no baseline: %s\n", name, rate,
+			strerror (errno));
+		return 0;
+	}
+
+	if (fscanf (f, "%lf", &base) == 1 &&
+	    rate < base * (1 - threshold / 100)) {
+		printf ("%s: throughput regression: %.0f blocks/s, "
+			"baseline %.0f\n", name, rate, base);
+		ok = 0;
+	}
+	else
+		printf ("%s: %.0f blocks/s, baseline %.0f\n", name, rate, base);
+
+	fclose (f);
+	return ok;
+}
+
+/*
+ * Asynchronous probe device: the probe completes on waiting poll only,
+ * motions sent while the probe is pending are counted
+ */
+struct async {
+	struct ngc_device device;
+	int pending, overlap;
+	struct ngc_result done;
+	double z;			/* last line end point Z	*/
+};
+
+static struct async *async (struct ngc_device *o)
+{
+	return (struct async *) o;
+}
+
+static int async_line (struct ngc_device *o, int abs, double *end)
+{
+	async (o)->overlap += async (o)->pending;
+	async (o)->z = end[2];
+	return 1;
+}
+
+static int async_probe (struct ngc_device *o, double *end)
+{
+	struct async *a = async (o);
+
+	a->pending = 1;
+	a->done.op = NGC_OP_PROBE;
+	a->done.ok = 1;
+	memcpy (a->done.pos, end, sizeof (a->done.pos));
+	return NGC_PENDING;
+}
+
+static int async_poll (struct ngc_device *o, struct ngc_result *r, int wait)
+{
+	if (!async (o)->pending || !wait)
+		return 0;
+
+	*r = async (o)->done;
+	async (o)->pending = 0;
+	return 1;
+}
+
+static const struct ngc_driver async_driver = {
+	.name		= "async",
+	.line		= async_line,
+	.probe		= async_probe,
+	.poll		= async_poll,
+};
+
+/*
+ * Blocks independent of the probed axis run while the probe is pending,
+ * the block reading the probe result waits for it
+ */
+static int check_async (const char *dir)
+{
+	static const char text[] = "G38.2 Z-10 F100\n"
+				   "G1 X5 Z0\n"
+				   "G1 X10 Z1\n"
+				   "G1 Z#5063\n"
+				   "M2\n";
+	struct async a = { .device.driver = &async_driver };
+	struct ngc_state s = {};
+	FILE *in;
+	int ok = 0;
+
+	if ((s.var = calloc (NGC_VSIZE, sizeof (s.var[0]))) == NULL)
+		return 0;
+
+	if ((in = fmemopen ((void *) text, sizeof (text) - 1, "r")) == NULL)
+		goto no_in;
+
+	if (!(ngc_state_reset (&s) && ngc_run (&s, in, &a.device)))
+		printf ("async probe: execution failed\n");
+	else if (a.overlap != 2 || a.pending || a.z != -10)
+		printf ("async probe: %d blocks run while pending, want 2, "
+			"end Z %g, want -10\n", a.overlap, a.z);
+	else
+		ok = 1;
+
+	fclose (in);
+no_in:
+	free (s.var);
+	return ok;
+}
+
+/*
+ * Feed motion without a feed rate is rejected before it is executed, the
+ * diagnostics go to a scratch log
+ */
+static int check_zero_feed (const char *dir)
+{
+	static const char text[] = "G94 G1 X10\n"
+				   "M2\n";
+	struct ngc_state s = {};
+	struct ngc_device *dev;
+	char *log = NULL;
+	size_t size;
+	FILE *in;
+	int ok = 0;
+
+	if ((s.var = calloc (NGC_VSIZE, sizeof (s.var[0]))) == NULL)
+		return 0;
+
+	if ((dev = ngc_device_alloc ("sim")) == NULL)
+		goto no_dev;
+
+	if ((in = fmemopen ((void *) text, sizeof (text) - 1, "r")) == NULL)
+		goto no_in;
+
+	if ((s.ctx.log = open_memstream (&log, &size)) == NULL)
+		goto no_log;
+
+	if (ngc_state_reset (&s) && ngc_run (&s, in, dev))
+		printf ("zero feed: G1 without feed rate is executed\n");
+	else if (fflush (s.ctx.log) != 0 || strstr (log, "zero feed") == NULL)
+		printf ("zero feed: no diagnostic: %s\n", log);
+	else
+		ok = 1;
+
+	fclose (s.ctx.log);
+	free (log);
+no_log:
+	fclose (in);
+no_in:
+	ngc_device_free (dev);
+no_dev:
+	free (s.var);
+	return ok;
+}
+
+/*
+ * Persistent parameters survive binary save and load, and text export
+ * and import. Images out of the persistent range are rejected.
+ */
+static int check_param_image (const char *path, double *var, const char *what)
+{
+	int i;
+
+	for (i = NGC_PARAM_FIRST; i <= NGC_PARAM_LAST; ++i)
+		var[i] = 0;
+
+	if (!(what[0] == 'l' ? ngc_param_load   (var, path) :
+			       ngc_param_import (var, path))) {
+		printf ("params: %s failed: %s\n", what, strerror (errno));
+		return 0;
+	}
+
+	for (i = NGC_PARAM_FIRST; i <= NGC_PARAM_LAST; ++i)
+		if (var[i] != i + 0.25) {
+			printf ("params: %s: #%d = %g, want %g\n", what, i,
+				var[i], i + 0.25);
+			return 0;
+		}
+
+	return 1;
+}
+
+static int check_param (const char *dir)
+{
+	struct { char magic[8]; uint32_t first, count; double v; } bad = {
+		.magic = NGC_PARAM_MAGIC, .first = 100000, .count = 1,
+	};
+	char path[512];
+	double *var;
+	FILE *f;
+	int i, ok = 0;
+
+	if ((var = calloc (NGC_VSIZE, sizeof (var[0]))) == NULL)
+		return 0;
+
+	snprintf (path, sizeof (path), "%s/param.tmp", dir);
+
+	for (i = NGC_PARAM_FIRST; i <= NGC_PARAM_LAST; ++i)
+		var[i] = i + 0.25;
+
+	if (!ngc_param_save (var, path) ||
+	    !check_param_image (path, var, "load") ||
+	    !ngc_param_export (var, path) ||
+	    !check_param_image (path, var, "import"))
+		goto out;
+
+	if ((f = fopen (path, "wb")) == NULL ||
+	    fwrite (&bad, sizeof (bad), 1, f) != 1 || fclose (f) != 0)
+		goto out;
+
+	if (ngc_param_load (var, path))
+		printf ("params: image out of range is loaded\n");
+	else
+		ok = 1;
+out:
+	unlink (path);
+	free (var);
+	return ok;
+}
+
+/*
+ * Run program text on the device, diagnostics go to the scratch log
+ */
+static int run_text (struct ngc_state *s, const char *text,
+		     struct ngc_device *dev)
+{
+	FILE *in;
+	int ok;
+
+	if ((in = fmemopen ((void *) text, strlen (text), "r")) == NULL)
+		return 0;
+
+	ok = ngc_run (s, in, dev);
+	fclose (in);
+	return ok;
+}
+
+static int state_init (struct ngc_state *s, FILE *log)
+{
+	memset (s, 0, sizeof (*s));
+
+	if ((s->var = calloc (NGC_VSIZE, sizeof (s->var[0]))) == NULL)
+		return 0;
+
+	s->ctx.log = log;
+	return ngc_state_reset (s);
+}
+
+static int write_file (const char *path, const char *text)
+{
+	FILE *f;
+
+	if ((f = fopen (path, "w")) == NULL)
+		return 0;
+
+	fputs (text, f);
+	return fclose (f) == 0;
+}
+
+/*
+ * Tool table reload: the next tool change takes data from the new
+ * table, a tool missing from the table is an error
+ */
+static int check_tools (const char *dir)
+{
+	struct ngc_state s;
+	struct ngc_device *dev = NULL;
+	struct ngc_tools *tools;
+	struct ngc_tool_data t;
+	FILE *log = fopen ("/dev/null", "w");
+	char path[512];
+	int ok = 0;
+
+	snprintf (path, sizeof (path), "%s/tools.tmp", dir);
+
+	if ((tools = ngc_tools_alloc ()) == NULL || !state_init (&s, log) ||
+	    (dev = ngc_device_alloc ("sim")) == NULL)
+		goto out;
+
+	s.ctx.tools = tools;
+
+	if (!write_file (path, "T1 P1 Z10 D6\n") ||
+	    !ngc_tools_load (tools, path) ||
+	    !run_text (&s, "T1 M6\nG43 H1\n", dev))
+		printf ("tools: first table is not used\n");
+	else if (s.var[NGC_TOOL_Z] != 10 || s.var[NGC_TOOL_D] != 6)
+		printf ("tools: tool 1 Z %g D %g, want 10 and 6\n",
+			s.var[NGC_TOOL_Z], s.var[NGC_TOOL_D]);
+	else if (!write_file (path, "T1 P1 Z12 D6\nT2 P2 Z3 D4\n") ||
+		 !ngc_tools_load (tools, path) ||
+		 !run_text (&s, "T2 M6\nG43 H2\n", dev))
+		printf ("tools: reloaded table is not used\n");
+	else if (s.var[NGC_TOOL_Z] != 3 || !ngc_tools_get (tools, 1, &t) ||
+		 t.offset[2] != 12)
+		printf ("tools: reloaded data is stale\n");
+	else if (ngc_tools_get (tools, 7, &t) ||
+		 run_text (&s, "G43 H7\n", dev))
+		printf ("tools: missing tool is accepted\n");
+	else
+		ok = 1;
+out:
+	unlink (path);
+	ngc_device_free (dev);
+	ngc_tools_free (tools);
+	free (s.var);
+	fclose (log);
+	return ok;
+}
+
+/*
+ * Seek and step back restore the state seen on the forward run, a failed
+ * step leaves parameters set by the failed line untouched
+ */
+static int check_scrub (const char *dir)
+{
+	static const char text[] = "G21 G90 G94\n"
+				   "G0 X0 Y0 Z5\n"
+				   "#1 = 3\n"
+				   "G1 X#1 F100\n"
+				   "G10 L2 P1 X1\n"
+				   "G1 Y2\n"
+				   "G91 G1 X1\n"
+				   "G90 G18\n"
+				   "#2 = 7\n"
+				   "G1 X2 Z2\n"
+				   "G17 G0 X0\n"
+				   "M2\n";
+	static const long seq[] = { 3, 10, 0, 7, 12, 1, 5, 5, 9, 2 };
+	const size_t vlen = NGC_VSIZE * sizeof (double);
+	struct ngc_state s;
+	struct ngc_device *dev = NULL;
+	struct ngc_scrub *o = NULL;
+	double *seen = NULL;
+	FILE *log = fopen ("/dev/null", "w");
+	long n, i;
+	int ok = 0;
+
+	if (!state_init (&s, log) || (dev = ngc_device_alloc ("sim")) == NULL ||
+	    (seen = malloc (13 * vlen)) == NULL ||
+	    (o = ngc_scrub_alloc (&s, dev, text, sizeof (text) - 1, 3)) == NULL)
+		goto out;
+
+	for (n = 0, memcpy (seen, s.var, vlen); n < 12 && ngc_scrub_step (o);)
+		memcpy (seen + ++n * NGC_VSIZE, s.var, vlen);
+
+	if (n != 12 || !ngc_scrub_end (o)) {
+		printf ("scrub: %ld blocks run, want 12\n", n);
+		goto out;
+	}
+
+	for (i = 0; i < (long) (sizeof (seq) / sizeof (seq[0])); ++i)
+		if (!ngc_scrub_seek (o, seq[i]) ||
+		    memcmp (s.var, seen + seq[i] * NGC_VSIZE, vlen) != 0) {
+			printf ("scrub: seek to %ld differs\n", seq[i]);
+			goto out;
+		}
+
+	for (ngc_scrub_seek (o, n); n > 0; --n)
+		if (!ngc_scrub_back (o) ||
+		    memcmp (s.var, seen + (n - 1) * NGC_VSIZE, vlen) != 0) {
+			printf ("scrub: step back to %ld differs\n", n - 1);
+			goto out;
+		}
+
+	ngc_scrub_free (o);
+
+	ngc_state_reset (&s);
+	s.var[1] = 0;
+
+	if ((o = ngc_scrub_alloc (&s, dev, "G21 G94\n#1 = 5 G1 X1\n", 21, 3))
+	    == NULL)
+		goto out;
+
+	if (!ngc_scrub_step (o) || ngc_scrub_step (o) ||
+	    ngc_scrub_pos (o) != 1 || s.var[1] != 0)
+		printf ("scrub: failed step is not rolled back, #1 = %g\n",
+			s.var[1]);
+	else
+		ok = 1;
+out:
+	ngc_scrub_free (o);
+	ngc_device_free (dev);
+	free (seen);
+	free (s.var);
+	fclose (log);
+	return ok;
+}
+
+/*
+ * Tool path of a program run on the simulator, NULL on failure
+ */
+static struct ngc_index *trace_index (const char *text,
+				      struct ngc_tools *tools, int threads)
+{
+	struct ngc_toolpath tp = {};
+	struct ngc_index *index = NULL;
+	struct ngc_device *dev;
+	struct ngc_state s;
+
+	if (!state_init (&s, NULL) || (dev = ngc_device_alloc ("sim")) == NULL)
+		goto no_dev;
+
+	s.ctx.tools = tools;
+	ngc_sim_toolpath (dev, &tp);
+
+	if (run_text (&s, text, dev))
+		index = ngc_index_build (&tp, threads);
+
+	ngc_toolpath_fini (&tp);
+	ngc_device_free (dev);
+no_dev:
+	free (s.var);
+	return index;
+}
+
+static int box_cross (const struct ngc_seg *s, const double *lo,
+		      const double *hi)
+{
+	int i;
+
+	for (i = 0; i < 3; ++i)
+		if (s->hi[i] < lo[i] || s->lo[i] > hi[i])
+			return 0;
+
+	return 1;
+}
+
+/*
+ * Index queries match brute force search over the segments, saved index
+ * loads back the same, truncated file is rejected
+ */
+static int check_index_query (const struct ngc_index *x)
+{
+	static const double box[][6] = {
+		{ -1, -1, -5,  5,  5,  5 },
+		{ 12,  8, -2, 40, 40,  0 },
+		{ -9, -9, -9, -8, -8, -8 },
+	};
+	const size_t count = ngc_index_count (x);
+	size_t seg[64], n, i, j, want;
+	double p[3], dist, best, d;
+	long near;
+
+	for (i = 0; i < sizeof (box) / sizeof (box[0]); ++i) {
+		n = ngc_index_region (x, box[i], box[i] + 3, seg, 64);
+
+		for (j = 0, want = 0; j < count; ++j)
+			want += box_cross (ngc_index_seg (x, j), box[i],
+					   box[i] + 3);
+
+		for (j = 0; j < n && j < 64; ++j)
+			if (!box_cross (ngc_index_seg (x, seg[j]), box[i],
+					box[i] + 3))
+				break;
+
+		if (n != want || j < n) {
+			printf ("index: region %zu: %zu segments, want %zu\n",
+				i, n, want);
+			return 0;
+		}
+	}
+
+	for (i = 0; i < 27; ++i) {
+		p[0] = (i % 3) * 12 - 3;
+		p[1] = (i / 3 % 3) * 12 - 3;
+		p[2] = (i / 9) * 3 - 3;
+
+		near = ngc_index_nearest (x, p, &dist);
+
+		for (j = 0, best = INFINITY; j < count; ++j)
+			if ((d = ngc_seg_dist (ngc_index_seg (x, j), p)) < best)
+				best = d;
+
+		if (near < 0 || fabs (dist - best) > 1e-9) {
+			printf ("index: nearest to %g,%g,%g at %g, want %g\n",
+				p[0], p[1], p[2], dist, best);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int check_index (const char *dir)
+{
+	static const char text[] = "G21 G90 G94 G17\n"
+				   "G0 X0 Y0 Z2\n"
+				   "G1 Z-1 F200\n"
+				   "G1 X20\n"
+				   "G3 X20 Y20 I0 J10\n"
+				   "G2 X0 Y20 Z-2 R10\n"
+				   "G1 Y0\n"
+				   "G0 Z5\n"
+				   "G0 X30 Y30\n"
+				   "M2\n";
+	struct ngc_index *x, *y = NULL;
+	char path[512];
+	size_t i;
+	int ok = 0;
+
+	snprintf (path, sizeof (path), "%s/index.tmp", dir);
+
+	if ((x = trace_index (text, NULL, 2)) == NULL) {
+		printf ("index: cannot build: %s\n", strerror (errno));
+		return 0;
+	}
+
+	if (!check_index_query (x))
+		goto out;
+
+	if (!ngc_index_save (x, path) || (y = ngc_index_load (path)) == NULL) {
+		printf ("index: round trip failed: %s\n", strerror (errno));
+		goto out;
+	}
+
+	for (i = 0; i < ngc_index_count (x); ++i)
+		if (memcmp (ngc_index_seg (x, i), ngc_index_seg (y, i),
+			    sizeof (struct ngc_seg)) != 0)
+			break;
+
+	if (ngc_index_count (y) != ngc_index_count (x) ||
+	    i < ngc_index_count (x)) {
+		printf ("index: loaded segments differ\n");
+		goto out;
+	}
+
+	if (!check_index_query (y))
+		goto out;
+
+	ngc_index_free (y);
+
+	if (truncate (path, 64) != 0 ||
+	    (y = ngc_index_load (path)) != NULL || errno != EINVAL)
+		printf ("index: truncated file is loaded\n");
+	else
+		ok = 1;
+out:
+	unlink (path);
+	ngc_index_free (y);
+	ngc_index_free (x);
+	return ok;
+}
+
+/*
+ * Stock: a slot cut with a four millimeter tool removes its volume, a
+ * rapid plunge into the material is reported, the result does not
+ * depend on the number of threads
+ */
+static int check_stock (const char *dir)
+{
+	static const char text[] = "G21 G90 G94 G17\n"
+				   "T1 M6\n"
+				   "S1000 M3\n"
+				   "G0 X0 Y0 Z1\n"
+				   "G1 Z-1 F100\n"
+				   "G1 X10\n"
+				   "G0 Z1\n"
+				   "G0 X5 Y10\n"
+				   "G0 Z-1\n"
+				   "G0 Z1\n"
+				   "M2\n";
+	static const double lo[3] = { -5, -5, -5 }, hi[3] = { 15, 15, 0 };
+	const double slot = 10 * 4 + M_PI * 2 * 2;  /* one millimeter deep */
+	struct ngc_stock *a = NULL, *b = NULL;
+	struct ngc_index *x = NULL;
+	struct ngc_tools *tools;
+	const struct ngc_hit *h;
+	char path[512];
+	size_t n;
+	int ok = 0;
+
+	snprintf (path, sizeof (path), "%s/tools.tmp", dir);
+
+	if ((tools = ngc_tools_alloc ()) == NULL ||
+	    !write_file (path, "T1 P1 D4\n") || !ngc_tools_load (tools, path) ||
+	    (x = trace_index (text, tools, 1)) == NULL ||
+	    (a = ngc_stock_alloc (lo, hi, 0.1)) == NULL ||
+	    (b = ngc_stock_alloc (lo, hi, 0.1)) == NULL ||
+	    !ngc_stock_cut (a, x, tools, 1) ||
+	    !ngc_stock_cut (b, x, tools, 3)) {
+		printf ("stock: cut failed: %s\n", strerror (errno));
+		goto out;
+	}
+
+	h = ngc_stock_hits (a, &n);
+
+	if (ngc_stock_removed (a) != ngc_stock_removed (b))
+		printf ("stock: removed %g with one thread, %g with three\n",
+			ngc_stock_removed (a), ngc_stock_removed (b));
+	else if (fabs (ngc_stock_removed (a) / (slot + M_PI * 4) - 1) > 0.05)
+		printf ("stock: removed %g, want %g\n", ngc_stock_removed (a),
+			slot + M_PI * 4);
+	else if (n != 1 || h->type != NGC_HIT_RAPID || h->line != 9)
+		printf ("stock: %zu hits, want rapid plunge at line 9\n", n);
+	else
+		ok = 1;
+out:
+	unlink (path);
+	ngc_stock_free (b);
+	ngc_stock_free (a);
+	ngc_index_free (x);
+	ngc_tools_free (tools);
+	return ok;
+}
+
+/*
+ * Event time line: events are stamped with the time of dwells before
+ * them, unchanged spindle and coolant states are not posted
+ */
+static int check_events (const char *dir)
+{
+	static const char text[] = "G21\n"
+				   "S1000 M3\n"
+				   "G4 P2\n"
+				   "M8\n"
+				   "G4 P1.5\n"
+				   "S2000\n"
+				   "M5 M9\n"
+				   "M2\n";
+	static const struct ngc_event want[] = {
+		{ 0.0, 2, NGC_EVENT_SPINDLE, NGC_SPINDLE_CW,   1000 },
+		{ 2.0, 4, NGC_EVENT_COOLANT, NGC_COOLANT_FLOOD,   0 },
+		{ 3.5, 6, NGC_EVENT_SPINDLE, NGC_SPINDLE_CW,   2000 },
+		{ 3.5, 7, NGC_EVENT_SPINDLE, NGC_SPINDLE_STOP,    0 },
+		{ 3.5, 7, NGC_EVENT_COOLANT, 0,                   0 },
+		{ 3.5, 8, NGC_EVENT_END,     0,                   0 },
+	};
+	const size_t count = sizeof (want) / sizeof (want[0]);
+	struct ngc_timeline t = {};
+	struct ngc_device *dev = NULL;
+	struct ngc_state s;
+	size_t i;
+	int ok = 0;
+
+	if (!state_init (&s, NULL) ||
+	    (dev = ngc_device_alloc ("events")) == NULL)
+		goto out;
+
+	s.var[NGC_NO_MOTION] = 1;
+
+	if (!run_text (&s, text, dev) || !ngc_events_timeline (dev, &t)) {
+		printf ("events: execution failed\n");
+		goto out;
+	}
+
+	for (i = 0; i < count && i < t.count; ++i)
+		if (t.event[i].time != want[i].time ||
+		    t.event[i].line != want[i].line ||
+		    t.event[i].type != want[i].type ||
+		    t.event[i].op   != want[i].op   ||
+		    t.event[i].arg  != want[i].arg)
+			break;
+
+	if (i < count || t.count != count || t.time != 3.5)
+		printf ("events: event %zu of %zu differs\n", i, t.count);
+	else
+		ok = 1;
+out:
+	ngc_device_free (dev);
+	free (s.var);
+	return ok;
+}
+
+/*
+ * Dependency sets of decoded blocks
+ */
+static int check_deps (const char *dir)
+{
+	static const struct {
+		const char *line;
+		unsigned reads, writes;
+		long axes;
+	} want[] = {
+		{ "G21 G90 G17",   0, 0, 0 },
+		{ "#1 = #5063",    NGC_VC_PROBE, NGC_VC_USER, 0 },
+		{ "G1 X#1 F100",   NGC_VC_USER | NGC_VC_ORIGIN | NGC_VC_POS,
+				   NGC_VC_POS, NGC_AXIS & ~NGC_X },
+		{ "G2 X1 Y1 R1",   NGC_VC_ORIGIN | NGC_VC_POS, NGC_VC_POS,
+				   NGC_AXIS },
+		{ "G10 L2 P1 X0",  0, NGC_VC_ORIGIN, 0 },
+		{ "G38.2 Z-5",     NGC_VC_ORIGIN | NGC_VC_POS,
+				   NGC_VC_POS | NGC_VC_PROBE, NGC_AXIS },
+		{ "G28",           NGC_VC_HOME, 0, 0 },
+	};
+	struct ngc_state s, *b;
+	struct ngc_ring r;
+	char line[64];
+	size_t i;
+	int ok = 0;
+
+	if (!state_init (&s, NULL) || !ngc_ring_init (&r, 2, &s))
+		goto no_ring;
+
+	for (i = 0; i < sizeof (want) / sizeof (want[0]); ++i) {
+		b = ngc_ring_next (&r);
+		snprintf (line, sizeof (line), "%s\n", want[i].line);
+
+		if (!ngc_scan (b, line) || !ngc_parse (b, line) ||
+		    !ngc_deps (b)) {
+			printf ("deps: %s: decode failed\n", want[i].line);
+			goto out;
+		}
+
+		if (b->deps.reads != want[i].reads ||
+		    b->deps.writes != want[i].writes ||
+		    b->deps.axes != want[i].axes) {
+			printf ("deps: %s: reads %#x writes %#x axes %#lx\n",
+				want[i].line, b->deps.reads, b->deps.writes,
+				b->deps.axes);
+			goto out;
+		}
+	}
+
+	ok = 1;
+out:
+	ngc_ring_fini (&r);
+no_ring:
+	free (s.var);
+	return ok;
+}
+
+/*
+ * Command queue: concurrent producers lose and reorder nothing, injected
+ * blocks run between program blocks
+ */
+#define QUEUE_PRODUCERS	4
+#define QUEUE_COUNT	1000
+
+static struct ngc_queue *queue;
+
+static void *queue_producer (void *cookie)
+{
+	int id = (intptr_t) cookie, i;
+
+	for (i = 0; i < QUEUE_COUNT; ++i)
+		while (!ngc_queue_opt (queue, id, i)) {}
+
+	return NULL;
+}
+
+static int check_queue (const char *dir)
+{
+	pthread_t t[QUEUE_PRODUCERS];
+	int next[QUEUE_PRODUCERS] = {}, i, got = 0, bad = 0;
+	struct ngc_device *dev = NULL;
+	struct ngc_state s = {};
+	struct ngc_cmd *c;
+
+	if ((queue = ngc_queue_alloc ()) == NULL)
+		return 0;
+
+	for (i = 0; i < QUEUE_PRODUCERS; ++i)
+		pthread_create (t + i, NULL, queue_producer,
+				(void *) (intptr_t) i);
+
+	while (got < QUEUE_PRODUCERS * QUEUE_COUNT)
+		if ((c = ngc_queue_pop (queue)) != NULL) {
+			bad += c->type != NGC_CMD_OPT ||
+			       c->on != next[c->mask]++;
+			++got;
+			free (c);
+		}
+
+	for (i = 0; i < QUEUE_PRODUCERS; ++i)
+		pthread_join (t[i], NULL);
+
+	if (bad > 0) {
+		printf ("queue: %d commands out of order\n", bad);
+		goto out;
+	}
+
+	if (!state_init (&s, NULL) || (dev = ngc_device_alloc ("sim")) == NULL)
+		goto out;
+
+	s.ctx.queue = queue;
+	ngc_queue_block (queue, "G0 X7");
+
+	if (!run_text (&s, "G21 G90 G0 X1\nG0 Y2\n", dev) ||
+	    s.var[NGC_POS_X] != 7 || s.var[NGC_POS_Y] != 2)
+		printf ("queue: injected block is not run: X %g Y %g\n",
+			s.var[NGC_POS_X], s.var[NGC_POS_Y]);
+	else
+		bad = -1;
+out:
+	ngc_device_free (dev);
+	free (s.var);
+	ngc_queue_free (queue);
+	return bad < 0;
+}
+
+/*
+ * Comment channel: texts are interned, messages reach the device before
+ * the motions of their block, comments before the next stop
+ */
+struct notes {
+	struct ngc_device device;
+	char log[256];
+};
+
+static void notes_put (struct ngc_device *o, const char *fmt, const char *s)
+{
+	char *log = ((struct notes *) o)->log;
+	size_t len = strlen (log);
+
+	snprintf (log + len, sizeof (((struct notes *) o)->log) - len, fmt, s);
+}
+
+static int notes_line (struct ngc_device *o, int abs, double *end)
+{
+	notes_put (o, "%sline;", "");
+	return 1;
+}
+
+static int notes_stop (struct ngc_device *o, int opt)
+{
+	notes_put (o, "%sstop;", "");
+	return 1;
+}
+
+static int notes_comment (struct ngc_device *o, const char *s)
+{
+	notes_put (o, "c %s;", s);
+	return 1;
+}
+
+static int notes_message (struct ngc_device *o, const char *s)
+{
+	notes_put (o, "m %s;", s);
+	return 1;
+}
+
+static const struct ngc_driver notes_driver = {
+	.name		= "notes",
+	.line		= notes_line,
+	.stop		= notes_stop,
+	.comment	= notes_comment,
+	.message	= notes_message,
+};
+
+static int check_notes (const char *dir)
+{
+	static const char text[] = "(first)\n"
+				   "G21 G1 X1 F100\n"
+				   "G1 X2 (MSG, go)\n"
+				   "(PRINT, p)\n"
+				   "G1 X3\n"
+				   "M0\n"
+				   "M2\n";
+	static const char want[] = "line;c first;m go;line;line;c p;stop;";
+	struct notes d = { .device.driver = &notes_driver };
+	struct ngc_notes *n;
+	struct ngc_state s;
+	int ok = 0;
+
+	if ((n = ngc_notes_alloc ()) == NULL || !state_init (&s, NULL))
+		goto out;
+
+	s.ctx.notes = n;
+
+	if (ngc_notes_intern (n, "same") != ngc_notes_intern (n, "same"))
+		printf ("notes: equal texts are stored twice\n");
+	else if (!run_text (&s, text, &d.device))
+		printf ("notes: execution failed\n");
+	else if (strncmp (d.log, want, sizeof (want) - 1) != 0)
+		printf ("notes: delivered %s\n\twant %s\n", d.log, want);
+	else
+		ok = 1;
+out:
+	ngc_notes_free (n);
+	free (s.var);
+	return ok;
+}
+
+/*
+ * Packer carries the rounding error of incremental axis words: ten steps
+ * of 0.4 of the last digit sum up to four last digits
+ */
+static const char *self_dir = ".";
+
+static int check_pack (const char *dir)
+{
+	char path[512], cmd[1024], *line = NULL, *p;
+	double sum = 0;
+	size_t size = 0;
+	FILE *f;
+	int i, ok = 0;
+
+	snprintf (path, sizeof (path), "%s/pack.tmp", dir);
+
+	if ((f = fopen (path, "w")) == NULL)
+		return 0;
+
+	fprintf (f, "G21 G91 G94 F100\n");
+
+	for (i = 0; i < 10; ++i)
+		fprintf (f, "G1 X0.0004\n");
+
+	fprintf (f, "M2\n");
+
+	if (fclose (f) != 0)
+		goto out;
+
+	snprintf (cmd, sizeof (cmd), "%s/ngc-pack -p 3 %s", self_dir, path);
+
+	if ((f = popen (cmd, "r")) == NULL)
+		goto out;
+
+	while (getline (&line, &size, f) > 0)
+		if ((p = strchr (line, 'X')) != NULL)
+			sum += strtod (p + 1, NULL);
+
+	if (pclose (f) != 0)
+		printf ("pack: %s failed\n", cmd);
+	else if (fabs (sum - 0.004) > 0.0005)
+		printf ("pack: path X %g, want 0.004\n", sum);
+	else
+		ok = 1;
+out:
+	free (line);
+	unlink (path);
+	return ok;
+}
+
+/*
+ * Result cache: chained hashes depend on every chunk, entries round trip
+ * and are replaced
+ */
+static int check_cache (const char *dir)
+{
+	const uint64_t a = ngc_hash ("abc", 3, 0), b = ngc_hash ("abd", 3, 0);
+	const uint64_t key = ngc_hash ("def", 3, a);
+	char path[512], *data = NULL;
+	size_t size;
+	int ok = 0;
+
+	snprintf (path, sizeof (path), "%s/%016llx", dir,
+		  (unsigned long long) key);
+
+	if (a == b || key == ngc_hash ("def", 3, b) ||
+	    key != ngc_hash ("def", 3, ngc_hash ("abc", 3, 0)))
+		printf ("cache: chained hash does not follow chunks\n");
+	else if (ngc_cache_get (dir, key, &size) != NULL)
+		printf ("cache: missing entry is found\n");
+	else if (!ngc_cache_put (dir, key, "first", 5) ||
+		 !ngc_cache_put (dir, key, "second", 6) ||
+		 (data = ngc_cache_get (dir, key, &size)) == NULL ||
+		 size != 6 || memcmp (data, "second", 6) != 0)
+		printf ("cache: entry is not replaced\n");
+	else
+		ok = 1;
+
+	free (data);
+	unlink (path);
+	return ok;
+}
+
+/*
+ * Focused checks, the corpus directory is the scratch one
+ */
+static int (*const checks[]) (const char *dir) = {
+	check_async,
+	check_zero_feed,
+	check_param,
+	check_tools,
+	check_scrub,
+	check_index,
+	check_stock,
+	check_events,
+	check_deps,
+	check_queue,
+	check_notes,
+	check_pack,
+	check_cache,
+};
+
+static int filter (const struct dirent *e)
+{
+	size_t len = strlen (e->d_name);
+
+	return len > 4 && strcmp (e->d_name + len - 4, ".ngc") == 0;
+}
+
+int main (int argc, char *argv[])
+{
+	const char *dir = "tests";
+	struct dirent **list;
+	char name[256], path[512], *text, *p;
+	const int total = sizeof (checks) / sizeof (checks[0]);
+	int opt, count, i, fails = 0, failed = 0;
+	size_t size;
+
+	while ((opt = getopt (argc, argv, "rRut:")) != -1)
+		switch (opt) {
+		case 'r':	rates  = 1; break;
+		case 'R':	rates  = 2; break;
+		case 'u':	update = 1; break;
+		case 't':	threshold = atof (optarg); break;
+		default:	goto usage;
+		}
+
+	if (optind < argc)
+		dir = argv[optind];
+
+	if ((p = strrchr (argv[0], '/')) != NULL) {
+		*p = '\0';
+		self_dir = argv[0];
+	}
+
+	if ((count = scandir (dir, &list, filter, alphasort)) < 0) {
+		perror (dir);
+		return 1;
+	}
+
+	for (i = 0; i < count; ++i) {
+		snprintf (name, sizeof (name), "%s/%.*s", dir,
+			  (int) strlen (list[i]->d_name) - 4, list[i]->d_name);
+		snprintf (path, sizeof (path), "%s.ngc", name);
+
+		if ((text = load (path, &size)) == NULL) {
+			perror (path);
+			++fails;
+		}
+		else if (!check_trace (name, text, size) ||
+			 (rates && !check_rate (name, text, size)))
+			++fails;
+
+		free (text);
+		free (list[i]);
+	}
+
+	free (list);
+
+	for (i = 0; i < total; ++i)
+		failed += !checks[i] (dir);
+
+	printf ("%d of %d programs failed, %d of %d checks failed\n",
+		fails, count, failed, total);
+	return fails > 0 || failed > 0;
+usage:
+	fprintf (stderr, "usage:\n\tngc-exec-test [-u] [-r | -R] "
+			 "[-t threshold] [corpus-dir]\n");
+	return 1;
+}
@@ -7,40 +7,57 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
-#include <strings.h>
+#include <math.h>
+#include <string.h>
 
+#include "ngc-feed.h"
 #include "ngc-state.h"
 
 /*
- * 1. comment (includes message)
+ * 0. block marker for the device
  */
-static int ngc_exec_comment (struct ngc_state *o, struct ngc_device *dev)
+static int ngc_exec_mark (struct ngc_state *o, struct ngc_device *dev)
 {
-	const char *p = o->comment;
+	o->length = o->time = o->feed = 0;
+	return ngc_device_block (dev, o->line);
+}
 
-	if (p == NULL)
+/*
+ * 1. comment (includes message), posted into the comment channel if any
+ */
+static int ngc_exec_comment (struct ngc_state *o, struct ngc_device *dev)
+{
+	if (o->comment == NULL)
 		return 1;
 
-	if (strncasecmp (p, "MSG,", 4) == 0)
-		return ngc_device_message (dev, p + (p[4] == ' ' ? 5 : 4));
+	if (o->ctx.notes != NULL)
+		return ngc_notes_post (o->ctx.notes, dev, o->comment_type,
+				       o->line, o->comment);
 
-	return ngc_device_comment (dev, p);
+	return ngc_note_send (dev, o->comment_type, o->comment);
 }
 
 /*
  * 2. set feed rate mode (G93, G94 — inverse time or per minute)
+ *
+ * Inverse time feed is converted to units per minute for every motion,
+ * thus the device stays in the units per minute mode.
  */
 static
 int ngc_exec_set_feed_rate_mode (struct ngc_state *o, struct ngc_device *dev)
 {
+	int inv = o->var[NGC_INV];
+
 	switch (o->g[NGC_G5]) {
 	case NGC_G0930:
 		o->var[NGC_INV] = 1;
-		return ngc_device_mode (dev, NGC_MODE_RATE, NGC_RATE_CPM);
+		return 1;
 
 	case NGC_G0940:
 		o->var[NGC_INV] = 0;
-		return ngc_device_mode (dev, NGC_MODE_RATE, NGC_RATE_UPM);
+		return ngc_device_mode (dev, NGC_MODE_RATE, NGC_RATE_UPM) &&
+		       (!inv || (o->map & NGC_F) != 0 ||
+			ngc_device_conf (dev, NGC_CONF_RATE, o->var[NGC_FEED]));
 	}
 
 	return 1;
@@ -51,10 +68,13 @@ int ngc_exec_set_feed_rate_mode (struct ngc_state *o, struct ngc_device *dev)
  */
 static int ngc_exec_set_feed_rate (struct ngc_state *o, struct ngc_device *dev)
 {
-	if ((o->map & NGC_F) != 0)
-		return ngc_device_conf (dev, NGC_CONF_RATE, ngc_word (o, 'F'));
+	if ((o->map & NGC_F) == 0)
+		return 1;
 
-	return 1;
+	o->var[NGC_FEED] = ngc_word (o, 'F');
+
+	return ngc_is_inv_mode (o) ||
+	       ngc_device_conf (dev, NGC_CONF_RATE, o->var[NGC_FEED]);
 }
 
 /*
@@ -63,8 +83,42 @@ static int ngc_exec_set_feed_rate (struct ngc_state *o, struct ngc_device *dev)
 static
 int ngc_exec_set_spindle_speed (struct ngc_state *o, struct ngc_device *dev)
 {
-	if ((o->map & NGC_S) != 0)
-		return ngc_device_conf (dev, NGC_CONF_SPEED, ngc_word (o, 'S'));
+	if ((o->map & NGC_S) == 0)
+		return 1;
+
+	o->var[NGC_SPEED] = ngc_word (o, 'S');
+	return ngc_device_conf (dev, NGC_CONF_SPEED, o->var[NGC_SPEED]);
+}
+
+/*
+ * Take tool parameters in the range from the tool table if the table is
+ * attached, otherwise the parameters are left as set by the program. The
+ * origin must be recomposed if the tool length offset is active.
+ */
+static int ngc_exec_tool_data (struct ngc_state *o, int slot, int from, int to)
+{
+	struct ngc_tool_data t;
+	double data[NGC_TOOL_O - NGC_TOOL + 1];
+	int i;
+
+	if (o->ctx.tools == NULL)
+		return 1;
+
+	if (!ngc_tools_get (o->ctx.tools, slot, &t)) {
+		if (slot != 0)
+			return ngc_error (o, "Tool %d is not in the tool table",
+					  slot);
+
+		memset (&t, 0, sizeof (t));  /* no tool */
+	}
+
+	ngc_tool_vars (&t, data);
+
+	for (i = from; i <= to; ++i)
+		o->var[i] = data[i - NGC_TOOL];
+
+	if (from <= NGC_TOOL_W && to >= NGC_TOOL_X && o->var[NGC_TLO])
+		o->var[NGC_DIRTY] = 1;
 
 	return 1;
 }
@@ -75,13 +129,31 @@ int ngc_exec_set_spindle_speed (struct ngc_state *o, struct ngc_device *dev)
  */
 static int ngc_exec_change_tool (struct ngc_state *o, struct ngc_device *dev)
 {
-	int slot = ngc_word (o, 'T');
+	int slot;
+
+	if ((o->map & NGC_T) != 0) {
+		slot = ngc_word (o, 'T');
 
-	if ((o->map & NGC_T) != 0)
-		return ngc_device_tool (dev, NGC_TOOL_SELECT, slot);
+		if (!ngc_device_tool (dev, NGC_TOOL_SELECT, slot))
+			return 0;
 
-	if (o->g[NGC_M6] == NGC_M0060)
-		return ngc_device_tool (dev, NGC_TOOL_CHANGE, slot);
+		o->var[NGC_TOOL_NEXT] = slot;
+	}
+
+	if (o->g[NGC_M6] != NGC_M0060)
+		return 1;
+
+	slot = o->var[NGC_TOOL_NEXT];
+
+	if (!ngc_exec_tool_data (o, slot, NGC_TOOL, NGC_TOOL_O))
+		return 0;
+
+	switch (ngc_device_tool (dev, NGC_TOOL_CHANGE, slot)) {
+	case 0:
+		return 0;
+	case NGC_PENDING:
+		o->var[NGC_WAIT_OPS] = (int) o->var[NGC_WAIT_OPS] | NGC_OP_TOOL;
+	}
 
 	return 1;
 }
@@ -91,7 +163,7 @@ static int ngc_exec_change_tool (struct ngc_state *o, struct ngc_device *dev)
  */
 static int ngc_exec_conf_spindle (struct ngc_state *o, struct ngc_device *dev)
 {
-	double speed = ngc_word (o, 'S');
+	double speed = o->var[NGC_SPEED];
 
 	switch (o->g[NGC_M7]) {
 	case NGC_M0030:
@@ -161,28 +233,31 @@ static int ngc_exec_dwell (struct ngc_state *o, struct ngc_device *dev)
 static
 int ngc_exec_set_active_plane (struct ngc_state *o, struct ngc_device *dev)
 {
-	switch (o->g[NGC_G2]) {
-	case NGC_G0170:
-		return ngc_device_mode (dev, NGC_MODE_PLANE, NGC_PLANE_XY);
+	int plane;
 
-	case NGC_G0180:
-		return ngc_device_mode (dev, NGC_MODE_PLANE, NGC_PLANE_XZ);
-
-	case NGC_G0190:
-		return ngc_device_mode (dev, NGC_MODE_PLANE, NGC_PLANE_YZ);
+	switch (o->g[NGC_G2]) {
+	case NGC_G0170:		plane = NGC_PLANE_XY; break;
+	case NGC_G0180:		plane = NGC_PLANE_XZ; break;
+	case NGC_G0190:		plane = NGC_PLANE_YZ; break;
+	default:		return 1;
 	}
 
-	return 1;
+	o->var[NGC_PLANE] = plane;
+	return ngc_device_mode (dev, NGC_MODE_PLANE, plane);
 }
 
 /*
  * 12. set length units (G20, G21)
+ *
+ * Device stays in millimeters if lengths are normalised by parser.
  */
 static int ngc_exec_set_units (struct ngc_state *o, struct ngc_device *dev)
 {
 	switch (o->g[NGC_G6]) {
 	case NGC_G0200:
-		return ngc_device_mode (dev, NGC_MODE_UNITS, NGC_UNITS_INCHES);
+		return ngc_device_mode (dev, NGC_MODE_UNITS,
+					o->var[NGC_METRIC] ? NGC_UNITS_MM :
+							     NGC_UNITS_INCHES);
 
 	case NGC_G0210:
 		return ngc_device_mode (dev, NGC_MODE_UNITS, NGC_UNITS_MM);
@@ -197,22 +272,61 @@ static int ngc_exec_set_units (struct ngc_state *o, struct ngc_device *dev)
 static int
 ngc_exec_conf_cutter_radius_comp (struct ngc_state *o, struct ngc_device *dev)
 {
+#if NGC_HAS_COMP
 	int slot = (o->map & NGC_D) != 0 ? ngc_word (o, 'D') : 0 /* current */;
-
+#endif
 	switch (o->g[NGC_G7]) {
 	case NGC_G0400:
+#if NGC_HAS_COMP
+		o->var[NGC_COMP] = 0;
+#endif
 		return ngc_device_cutter (dev, NGC_CUTTER_C, -1);  /* off */
-
+#if NGC_HAS_COMP
 	case NGC_G0410:
-		return ngc_device_cutter (dev, NGC_CUTTER_L, slot);
+		o->var[NGC_COMP] = 1;
+		return (slot == 0 ||
+			ngc_exec_tool_data (o, slot, NGC_TOOL_D, NGC_TOOL_D)) &&
+		       ngc_device_cutter (dev, NGC_CUTTER_L, slot);
 
 	case NGC_G0420:
-		return ngc_device_cutter (dev, NGC_CUTTER_R, slot);
+		o->var[NGC_COMP] = 1;
+		return (slot == 0 ||
+			ngc_exec_tool_data (o, slot, NGC_TOOL_D, NGC_TOOL_D)) &&
+		       ngc_device_cutter (dev, NGC_CUTTER_R, slot);
+#endif
 	}
 
 	return 1;
 }
 
+/*
+ * Compose program origin from the active coordinate system, axis offsets
+ * (G92) and tool length offset, and pass it to the device. The origin
+ * is cached in var and recomposed only when its sources change.
+ */
+static int ngc_exec_offset (struct ngc_state *o, struct ngc_device *dev)
+{
+	static const double zero[NGC_AXES];
+	double *origin = o->var + NGC_ORIGIN_X;
+	int cs = o->var[NGC_CS], i;
+
+	for (i = 0; i < NGC_AXES; ++i)
+		origin[i] = o->var[NGC_CS1_X + (cs - 1) * 20 + i];
+
+	if (o->var[NGC_OFFSET_ON])
+		for (i = 0; i < NGC_AXES; ++i)
+			origin[i] += o->var[NGC_OFFSET_X + i];
+
+	if (o->var[NGC_TLO])
+		for (i = 0; i < NGC_AXES; ++i)
+			origin[i] += o->var[NGC_TOOL_X + i];
+
+	o->var[NGC_DIRTY] = 0;
+
+	return ngc_device_offset (dev, o->var[NGC_MACHINE] ? (double *) zero :
+							     origin);
+}
+
 /*
  * 14. cutter length compensation on or off (G43, G49)
  */
@@ -226,10 +340,16 @@ static int ngc_exec_conf_cutter_length_comp (struct ngc_state *o, struct ngc_dev
 
 	switch (o->g[NGC_G8]) {
 	case NGC_G0430:
-		return ngc_device_tool (dev, NGC_TOOL_COMP, slot);
+		o->var[NGC_TLO] = 1;
+		return (slot == 0 ||
+			ngc_exec_tool_data (o, slot, NGC_TOOL_X, NGC_TOOL_W)) &&
+		       ngc_device_tool (dev, NGC_TOOL_COMP, slot) &&
+		       ngc_exec_offset (o, dev);
 
 	case NGC_G0490:
-		return ngc_device_tool (dev, NGC_TOOL_COMP, -1);  /* off */
+		o->var[NGC_TLO] = 0;
+		return ngc_device_tool (dev, NGC_TOOL_COMP, -1) &&  /* off */
+		       ngc_exec_offset (o, dev);
 	}
 
 	return 1;
@@ -239,21 +359,6 @@ static int ngc_exec_conf_cutter_length_comp (struct ngc_state *o, struct ngc_dev
  * 15. coordinate system selection (G54, G55, G56, G57, G58, G59, G59.1,
  *     G59.2, G59.3)
  */
-static int ngc_exec_offset (struct ngc_state *o, struct ngc_device *dev)
-{
-	double vec[6];
-	int cs = o->var[NGC_CS], i;
-
-	for (i = 0; i < 6; ++i)
-		vec[i] = o->var[NGC_CS1_X + cs * 20 + i];
-
-	if (o->var[NGC_OFFSET_ON])
-		for (i = 0; i < 6; ++i)
-			vec[i] += o->var[NGC_OFFSET_X + i];
-
-	return ngc_device_offset (dev, vec);
-}
-
 static
 int ngc_exec_select_coord_system (struct ngc_state *o, struct ngc_device *dev)
 {
@@ -269,7 +374,8 @@ int ngc_exec_select_coord_system (struct ngc_state *o, struct ngc_device *dev)
 	case NGC_G0591:		cs = 7; break;
 	case NGC_G0592:		cs = 8; break;
 	case NGC_G0593:		cs = 9; break;
-	default:		return 1;
+	default:
+		return o->var[NGC_DIRTY] ? ngc_exec_offset (o, dev) : 1;
 	}
 
 	o->var[NGC_CS] = cs;
@@ -322,9 +428,11 @@ int ngc_exec_set_retract_mode (struct ngc_state *o, struct ngc_device *dev)
 {
 	switch (o->g[NGC_G10]) {
 	case NGC_G0980:
+		o->var[NGC_RETRACT] = 1;
 		return ngc_device_opt (dev, NGC_OPT_RETRACT_BACK, 1);
 
 	case NGC_G0990:
+		o->var[NGC_RETRACT] = 0;
 		return ngc_device_opt (dev, NGC_OPT_RETRACT_BACK, 0);
 	}
 
@@ -333,36 +441,73 @@ int ngc_exec_set_retract_mode (struct ngc_state *o, struct ngc_device *dev)
 
 /*
  * Axis helpers
+ *
+ * Axis words are selected by the word map bits: the new coordinate is
+ * taken from the word if it is set explicitly, and from the base vector
+ * otherwise. No per-axis branches, so the loop is a simple blend.
  */
+static const char ngc_axis_word[NGC_AXES] = {
+	'X' - 'A', 'Y' - 'A', 'Z' - 'A',
+	'A' - 'A', 'B' - 'A', 'C' - 'A',
+	'U' - 'A', 'V' - 'A', 'W' - 'A',
+};
+
+static void ngc_axis_blend (struct ngc_state *o, const double *base, double *v)
+{
+	int i, w;
+
+	for (i = 0; i < NGC_AXES; ++i) {
+		w = ngc_axis_word[i];
+		v[i] = (o->map >> w) & 1 ? o->word[w] : base[i];
+	}
+}
+
 static void ngc_axis_zero (double *v)
 {
 	int i;
 
-	for (i = 0; i < 6; ++i)
+	for (i = 0; i < NGC_AXES; ++i)
 		v[i] = 0;
 }
 
 static void ngc_axis_copy (struct ngc_state *o, double *v)
 {
-	if ((o->map & NGC_X) != 0)	v[0] = ngc_word (o, 'X');
-	if ((o->map & NGC_Y) != 0)	v[1] = ngc_word (o, 'Y');
-	if ((o->map & NGC_Z) != 0)	v[2] = ngc_word (o, 'Z');
-	if ((o->map & NGC_A) != 0)	v[3] = ngc_word (o, 'A');
-	if ((o->map & NGC_B) != 0)	v[4] = ngc_word (o, 'B');
-	if ((o->map & NGC_C) != 0)	v[5] = ngc_word (o, 'C');
+	ngc_axis_blend (o, v, v);
+}
+
+/*
+ * Motion end point for the device: program coordinates, or machine
+ * coordinates if the device is in machine mode and the point is given
+ * in absolute program coordinates.
+ */
+static double *ngc_exec_target (struct ngc_state *o, int abs, double *v)
+{
+	if (!o->var[NGC_MACHINE] || abs || o->var[NGC_REL])
+		return o->axis;
+
+	memcpy (v, o->axis, sizeof (o->axis));
+	ngc_xform (o->var, v);
+	return v;
 }
 
+/*
+ * Blend axis words with the current point: the end point in absolute
+ * mode (machine coordinates for G53) and the distance in relative one.
+ */
 static void ngc_axis_prepare (struct ngc_state *o)
 {
-	static const double zero[6];
-	const double *axis = o->var[NGC_REL] ? zero : o->prev->axis;
+	double *pos = o->var + NGC_POS_X;
+	int i;
+
+	if (o->var[NGC_REL])
+		ngc_axis_zero (o->axis);
+	else if (o->g[NGC_G0] == NGC_G0530)
+		for (i = 0; i < NGC_AXES; ++i)
+			o->axis[i] = pos[i] + o->var[NGC_ORIGIN_X + i];
+	else
+		memcpy (o->axis, pos, sizeof (o->axis));
 
-	o->axis[0] = (o->map & NGC_X) != 0 ? ngc_word (o, 'X') : axis[0];
-	o->axis[1] = (o->map & NGC_Y) != 0 ? ngc_word (o, 'Y') : axis[1];
-	o->axis[2] = (o->map & NGC_Z) != 0 ? ngc_word (o, 'Z') : axis[2];
-	o->axis[3] = (o->map & NGC_A) != 0 ? ngc_word (o, 'A') : axis[3];
-	o->axis[4] = (o->map & NGC_B) != 0 ? ngc_word (o, 'B') : axis[4];
-	o->axis[5] = (o->map & NGC_C) != 0 ? ngc_word (o, 'C') : axis[5];
+	ngc_axis_copy (o, o->axis);
 }
 
 /*
@@ -377,10 +522,10 @@ static int ngc_exec_shift (struct ngc_state *o, struct ngc_device *dev)
 	if (!o->var[NGC_OFFSET_ON])
 		ngc_axis_zero (o->var + NGC_OFFSET_X);
 
-	for (i = 0; i < 6; ++i)
+	for (i = 0; i < NGC_AXES; ++i)
 		o->var[NGC_OFFSET_X + i] += o->var[NGC_REL] ?
 			o->axis[i] :
-			o->axis[i] - o->prev->axis[i];
+			o->axis[i] - o->var[NGC_POS_X + i];
 
 	o->var[NGC_OFFSET_ON] = 1;
 	return ngc_exec_offset (o, dev);
@@ -388,26 +533,29 @@ static int ngc_exec_shift (struct ngc_state *o, struct ngc_device *dev)
 
 static int ngc_exec_conf_offset (struct ngc_state *o, struct ngc_device *dev)
 {
-	int cs;
+	double v[NGC_AXES];
 
 	ngc_axis_prepare (o);
 
 	switch (o->g[NGC_G0]) {
+#if NGC_HAS_G10
 	case NGC_G0100:
-		if (ngc_word (o, 'L') == 2) {
-			cs = ngc_word (o, 'P');
-			ngc_axis_copy (o, o->var + NGC_CS1_X + (cs - 1) * 20);
-		}
+		if (ngc_word (o, 'L') == 2)  /* P is coordinate system */
+			ngc_axis_copy (o, o->var + NGC_CS1_X +
+					  ((int) ngc_word (o, 'P') - 1) * 20);
 
 		return ngc_exec_offset (o, dev);
+#endif
 
 	case NGC_G0280:
-		return ngc_device_move (dev, 0, o->axis) &&
-		       ngc_device_home (dev, 0);
+		return o->var[NGC_NO_MOTION] ||
+		       (ngc_device_move (dev, 0, ngc_exec_target (o, 0, v)) &&
+			ngc_device_home (dev, 0));
 
 	case NGC_G0300:
-		return ngc_device_move (dev, 0, o->axis) &&
-		       ngc_device_home (dev, 1);
+		return o->var[NGC_NO_MOTION] ||
+		       (ngc_device_move (dev, 0, ngc_exec_target (o, 0, v)) &&
+			ngc_device_home (dev, 1));
 
 	case NGC_G0920:
 		return ngc_exec_shift (o, dev);
@@ -431,20 +579,395 @@ static int ngc_exec_conf_offset (struct ngc_state *o, struct ngc_device *dev)
 /*
  * 20. perform motion (G0 to G3, G80 to G89), as modified (possibly) by G53
  */
+
+/*
+ * Motion distances along axes in program coordinates
+ */
+static void ngc_exec_delta (struct ngc_state *o, double *d)
+{
+	int i;
+
+	for (i = 0; i < NGC_AXES; ++i)
+		d[i] = o->var[NGC_REL] ? o->axis[i] :
+		       o->g[NGC_G0] == NGC_G0530 ?
+		       o->axis[i] - o->var[NGC_ORIGIN_X + i] -
+				    o->var[NGC_POS_X + i] :
+		       o->axis[i] - o->var[NGC_POS_X + i];
+}
+
+/*
+ * In the no-motion mode motions are not sent to the device, the device
+ * dwells for the estimated duration of the motion instead: feed motions
+ * take their feed time, rapid motions take the traverse rate if it is
+ * set (in millimeters per minute), homing motions take no time. Probes
+ * are still sent as their results are program data.
+ */
+static int ngc_exec_idle (struct ngc_device *dev, double time)
+{
+	return time <= 0 || ngc_device_dwell (dev, time * 60);
+}
+
+static double ngc_exec_rapid_time (struct ngc_state *o, const double *d)
+{
+	const double rate = o->var[NGC_RAPID];
+	double scale = 1;
+
+	if (!o->var[NGC_METRIC] && ngc_modal (o, NGC_G6) == NGC_G0200)
+		scale = 25.4;
+
+	return rate > 0 ? ngc_feed_length (d, 0) * scale / rate : 0;
+}
+
+static int ngc_exec_move (struct ngc_state *o, struct ngc_device *dev, int abs)
+{
+	double v[NGC_AXES];
+
+	if (!o->var[NGC_NO_MOTION])
+		return ngc_device_move (dev, abs, ngc_exec_target (o, abs, v));
+
+	ngc_exec_delta (o, v);
+	return ngc_exec_idle (dev, ngc_exec_rapid_time (o, v));
+}
+
+/*
+ * Feed motion segment: the length, duration and feed rate of the motion.
+ * Inverse time feed is passed to the device in units per minute.
+ */
+static int ngc_exec_feed (struct ngc_state *o, struct ngc_device *dev,
+			  const double *d, double arc)
+{
+	double F = o->var[NGC_FEED];
+
+	o->length = ngc_feed_length (d, arc);
+
+	if (!ngc_is_inv_mode (o)) {
+		o->time = o->length / F;
+		o->feed = F;
+		return 1;
+	}
+
+	o->time = 1 / F;
+	o->feed = o->length * F;
+
+	/* keep rate of zero length motion, it takes no time anyway */
+	return o->feed == 0 ||
+	       ngc_device_conf (dev, NGC_CONF_RATE, o->feed);
+}
+
+static int ngc_exec_line (struct ngc_state *o, struct ngc_device *dev, int abs)
+{
+	double v[NGC_AXES];
+
+	ngc_exec_delta (o, v);
+
+	if (!ngc_exec_feed (o, dev, v, 0))
+		return 0;
+
+	if (o->var[NGC_NO_MOTION])
+		return ngc_exec_idle (dev, o->time);
+
+	return ngc_device_line (dev, abs, ngc_exec_target (o, abs, v));
+}
+
+/*
+ * Arc in the active plane: a and b are plane axes ordered to keep the
+ * plane normal positive, the arc length in the plane is r * sweep.
+ */
+static void ngc_exec_plane (struct ngc_state *o, int *a, int *b)
+{
+	switch ((int) o->var[NGC_PLANE]) {
+	case NGC_PLANE_XZ:	*a = 2, *b = 0; break;
+	case NGC_PLANE_YZ:	*a = 1, *b = 2; break;
+	default:		*a = 0, *b = 1; break;
+	}
+}
+
+static double ngc_arc_center (const double *d, const double *offs,
+			      int a, int b, int cw)
+{
+	double r  = hypot (offs[a], offs[b]);
+	double as = atan2 (-offs[b], -offs[a]);
+	double ae = atan2 (d[b] - offs[b], d[a] - offs[a]);
+	double sweep = cw ? as - ae : ae - as;
+
+	if (sweep <= 1e-12)
+		sweep += 2 * M_PI;
+
+	return r * sweep;
+}
+
+static double ngc_arc_radius (const double *d, double r, int a, int b)
+{
+	double c = hypot (d[a], d[b]) / (2 * fabs (r));
+	double sweep = 2 * asin (c < 1 ? c : 1);
+
+	return fabs (r) * (r < 0 ? 2 * M_PI - sweep : sweep);
+}
+
 static int ngc_exec_arc (struct ngc_state *o, struct ngc_device *dev, int cw)
 {
-	double r, offs[3];
+	double r = 0, offs[3], v[NGC_AXES], d[NGC_AXES], arc, *end;
+	int a, b;
+
+	ngc_exec_plane (o, &a, &b);
+	ngc_exec_delta (o, d);
 
 	if ((o->map & NGC_R) != 0) {
-		r = ngc_word (o, 'R');
-		return ngc_device_rarc (dev, o->axis, r, cw);
+		r   = ngc_word (o, 'R');
+		arc = ngc_arc_radius (d, r, a, b);
+	}
+	else {
+		offs[0] = (o->map & NGC_I) != 0 ? ngc_word (o, 'I') : 0;
+		offs[1] = (o->map & NGC_J) != 0 ? ngc_word (o, 'J') : 0;
+		offs[2] = (o->map & NGC_K) != 0 ? ngc_word (o, 'K') : 0;
+		arc = ngc_arc_center (d, offs, a, b, cw);
+	}
+
+	d[a] = d[b] = 0;
+
+	if (!ngc_exec_feed (o, dev, d, arc))
+		return 0;
+
+	if (o->var[NGC_NO_MOTION])
+		return ngc_exec_idle (dev, o->time);
+
+	end = ngc_exec_target (o, 0, v);
+
+	return	(o->map & NGC_R) != 0 ?
+		ngc_device_rarc (dev, end, r, cw) :
+		ngc_device_carc (dev, end, offs, cw);
+}
+
+#if NGC_HAS_CYCLES
+/*
+ * Canned cycles (G81 to G89) are expanded into straight moves along the
+ * drilling axis h of the active plane. Positions are tracked in absolute
+ * program coordinates, or relative to the cycle start point in the
+ * incremental distance mode.
+ */
+struct ngc_cycle {
+	int h;				/* drilling axis		*/
+	double pos[NGC_AXES];		/* current point		*/
+	double r, bottom, clear;	/* drilling axis levels		*/
+};
+
+static int ngc_cycle_idle (struct ngc_state *o, struct ngc_device *dev,
+			   const double *d, int feed)
+{
+	double F = o->var[NGC_FEED];
+
+	if (!feed)
+		return ngc_exec_idle (dev, ngc_exec_rapid_time (o, d));
+
+	return F <= 0 || ngc_exec_idle (dev, ngc_feed_length (d, 0) / F);
+}
+
+static int ngc_cycle_go (struct ngc_state *o, struct ngc_device *dev,
+			 struct ngc_cycle *c, double level, int feed)
+{
+	double v[NGC_AXES];
+	int i;
+
+	if (o->var[NGC_NO_MOTION]) {
+		for (i = 0; i < NGC_AXES; ++i)
+			v[i] = i == c->h ? level - c->pos[i] : 0;
+
+		c->pos[c->h] = level;
+		return ngc_cycle_idle (o, dev, v, feed);
+	}
+
+	if (o->var[NGC_REL])
+		for (i = 0; i < NGC_AXES; ++i)
+			v[i] = i == c->h ? level - c->pos[i] : 0;
+	else {
+		memcpy (v, c->pos, sizeof (v));
+		v[c->h] = level;
+
+		if (o->var[NGC_MACHINE])
+			ngc_xform (o->var, v);
+	}
+
+	c->pos[c->h] = level;
+
+	return feed ? ngc_device_line (dev, 0, v) : ngc_device_move (dev, 0, v);
+}
+
+static int ngc_cycle_hole (struct ngc_state *o, struct ngc_device *dev,
+			   struct ngc_cycle *c)
+{
+	double v[NGC_AXES], d[NGC_AXES];
+	int i;
+
+	for (i = 0; i < NGC_AXES; ++i)
+		if (i == c->h)
+			d[i] = 0;
+		else if (o->var[NGC_REL])
+			c->pos[i] += d[i] = o->axis[i];
+		else {
+			d[i] = o->axis[i] - c->pos[i];
+			c->pos[i] = o->axis[i];
+		}
+
+	if (o->var[NGC_NO_MOTION])
+		return ngc_cycle_idle (o, dev, d, 0);
+
+	if (o->var[NGC_REL])
+		return ngc_device_move (dev, 0, d);
+
+	memcpy (v, c->pos, sizeof (v));
+
+	if (o->var[NGC_MACHINE])
+		ngc_xform (o->var, v);
+
+	return ngc_device_move (dev, 0, v);
+}
+
+static int ngc_cycle_peck (struct ngc_state *o, struct ngc_device *dev,
+			   struct ngc_cycle *c)
+{
+	double q = ngc_word (o, 'Q'), depth, next;
+
+	if ((o->map & NGC_Q) == 0 || q <= 0)
+		return ngc_error (o, "Positive Q word required for G83");
+
+	for (depth = c->r; depth > c->bottom; depth = next) {
+		next = depth - q > c->bottom ? depth - q : c->bottom;
+
+		if (!((depth == c->r || ngc_cycle_go (o, dev, c, depth, 0)) &&
+		      ngc_cycle_go (o, dev, c, next, 1) &&
+		      ngc_cycle_go (o, dev, c, c->r, 0)))
+			return 0;
 	}
 
-	offs[0] = (o->map & NGC_I) != 0 ? ngc_word (o, 'I') : 0;
-	offs[1] = (o->map & NGC_J) != 0 ? ngc_word (o, 'J') : 0;
-	offs[2] = (o->map & NGC_K) != 0 ? ngc_word (o, 'K') : 0;
+	return 1;
+}
+
+static int ngc_cycle_body (struct ngc_state *o, struct ngc_device *dev,
+			   struct ngc_cycle *c)
+{
+	double delay = (o->map & NGC_P) != 0 ? ngc_word (o, 'P') : 0;
+	double speed = o->var[NGC_SPEED];
+
+	switch (ngc_modal (o, NGC_G1)) {
+	case NGC_G0810:
+		return ngc_cycle_go (o, dev, c, c->bottom, 1);
+
+	case NGC_G0820:
+		return ngc_cycle_go (o, dev, c, c->bottom, 1) &&
+		       ngc_device_dwell (dev, delay);
+
+	case NGC_G0830:
+		return ngc_cycle_peck (o, dev, c);
+
+	case NGC_G0840:
+		return ngc_device_opt (dev, NGC_OPT_FEED_SYNC, 1) &&
+		       ngc_cycle_go (o, dev, c, c->bottom, 1) &&
+		       ngc_device_spindle (dev, NGC_SPINDLE_CCW, speed) &&
+		       ngc_cycle_go (o, dev, c, c->r, 1) &&
+		       ngc_device_spindle (dev, NGC_SPINDLE_CW, speed) &&
+		       ngc_device_opt (dev, NGC_OPT_FEED_SYNC, 0);
+
+	case NGC_G0850:
+		return ngc_cycle_go (o, dev, c, c->bottom, 1) &&
+		       ngc_cycle_go (o, dev, c, c->r, 1);
+
+	case NGC_G0860:
+		return ngc_cycle_go (o, dev, c, c->bottom, 1) &&
+		       ngc_device_dwell (dev, delay) &&
+		       ngc_device_spindle (dev, NGC_SPINDLE_STOP, 0) &&
+		       ngc_cycle_go (o, dev, c, c->clear, 0) &&
+		       ngc_device_spindle (dev, NGC_SPINDLE_CW, speed);
+
+	case NGC_G0880:
+		return ngc_cycle_go (o, dev, c, c->bottom, 1) &&
+		       ngc_device_dwell (dev, delay) &&
+		       ngc_device_spindle (dev, NGC_SPINDLE_STOP, 0) &&
+		       ngc_device_stop (dev, 0) &&
+		       ngc_device_spindle (dev, NGC_SPINDLE_CW, speed);
+
+	case NGC_G0890:
+		return ngc_cycle_go (o, dev, c, c->bottom, 1) &&
+		       ngc_device_dwell (dev, delay) &&
+		       ngc_cycle_go (o, dev, c, c->clear, 1);
+	}
+
+	return ngc_error (o, "Canned cycle G87 is not supported");
+}
+
+static int ngc_exec_canned (struct ngc_state *o, struct ngc_device *dev)
+{
+	static const int axis[] = { 2, 1, 0 };  /* by plane */
+	int count = (o->map & NGC_L) != 0 ? ngc_word (o, 'L') : 1, i, w;
+	struct ngc_cycle c;
+	double start;
+
+	c.h = axis[(int) o->var[NGC_PLANE]];
+
+	if (o->var[NGC_REL])
+		memset (c.pos, 0, sizeof (c.pos));
+	else
+		memcpy (c.pos, o->var + NGC_POS_X, sizeof (c.pos));
+
+	if ((o->map & NGC_R) != 0)
+		o->var[NGC_CYCLE_R] = ngc_word (o, 'R');
+
+	if (((o->map >> (w = ngc_axis_word[c.h])) & 1) != 0)
+		o->var[NGC_CYCLE_Z] = o->word[w];
+
+	start    = c.pos[c.h];
+	c.r      = o->var[NGC_CYCLE_R] + (o->var[NGC_REL] ? start : 0);
+	c.bottom = o->var[NGC_CYCLE_Z] + (o->var[NGC_REL] ? c.r   : 0);
+	c.clear  = o->var[NGC_RETRACT] && start > c.r ? start : c.r;
+
+	if (start < c.r && !ngc_cycle_go (o, dev, &c, c.r, 0))
+		return 0;
+
+	for (i = 0; i < count; ++i)
+		if (!(ngc_cycle_hole (o, dev, &c) &&
+		      ngc_cycle_go   (o, dev, &c, c.r, 0) &&
+		      ngc_cycle_body (o, dev, &c) &&
+		      ngc_cycle_go   (o, dev, &c, c.clear, 0)))
+			return 0;
+
+	memcpy (o->axis, c.pos, sizeof (o->axis));
+	return 1;
+}
+#endif
+
+/*
+ * Straight probe: the position of probed axes is unknown till the probe
+ * completes, devices without results trip at the end point
+ */
+static int ngc_exec_probe (struct ngc_state *o, struct ngc_device *dev)
+{
+	struct ngc_result r = { .op = NGC_OP_PROBE, .ok = 1 };
+	double v[NGC_AXES];
+	int ret = ngc_device_probe (dev, ngc_exec_target (o, 0, v)), i;
+
+	if (ret == 0)
+		return 0;
+
+	o->var[NGC_WAIT_OPS]  = (int)  o->var[NGC_WAIT_OPS] | NGC_OP_PROBE;
+	o->var[NGC_WAIT_AXES] = (long) o->var[NGC_WAIT_AXES] |
+				(o->map & NGC_AXIS);
+
+	if (ret == NGC_PENDING)
+		return 1;
+
+	if (ngc_device_poll (dev, &r, 0))
+		return ngc_complete (o, &r);
+
+	for (i = 0; i < NGC_AXES; ++i) {
+		r.pos[i] = o->axis[i];
+
+		if (o->var[NGC_REL])
+			r.pos[i] += o->var[NGC_POS_X + i];
+
+		if (o->var[NGC_MACHINE])
+			r.pos[i] += o->var[NGC_ORIGIN_X + i];
+	}
 
-	return ngc_device_carc (dev, o->axis, offs, cw);
+	return ngc_complete (o, &r);
 }
 
 static int ngc_exec_perform_motion (struct ngc_state *o, struct ngc_device *dev)
@@ -456,15 +979,15 @@ static int ngc_exec_perform_motion (struct ngc_state *o, struct ngc_device *dev)
 		return 1;
 	}
 
-	if (o->g[NGC_G1] == 0)
-		o->g[NGC_G1] = o->prev->g[NGC_G1];
+	if ((o->map & NGC_AXIS) == 0)  /* no motion without axis words */
+		return 1;
 
-	switch (o->g[NGC_G1]) {
+	switch (ngc_modal (o, NGC_G1)) {
 	case NGC_G0000:
-		return ngc_device_move (dev, abs, o->axis);
+		return ngc_exec_move (o, dev, abs);
 
 	case NGC_G0010:
-		return ngc_device_line (dev, abs, o->axis);
+		return ngc_exec_line (o, dev, abs);
 
 	case NGC_G0020:
 		return ngc_exec_arc (o, dev, 1);
@@ -473,17 +996,29 @@ static int ngc_exec_perform_motion (struct ngc_state *o, struct ngc_device *dev)
 		return ngc_exec_arc (o, dev, 0);
 
 	case NGC_G0382:
-		return ngc_device_probe (dev, o->axis);
+		return ngc_exec_probe (o, dev);
+
+#if NGC_HAS_CYCLES
+	case NGC_G0810: case NGC_G0820: case NGC_G0830: case NGC_G0840:
+	case NGC_G0850: case NGC_G0860: case NGC_G0870: case NGC_G0880:
+	case NGC_G0890:
+		return ngc_exec_canned (o, dev);
+#endif
 	}
 
 	return 1;
 }
 
 /*
- * 21. stop (M0, M1, M2, M30, M60)
+ * 21. stop (M0, M1, M2, M30, M60), the operator sees posted messages
+ * before the stop
  */
 static int ngc_exec_stop (struct ngc_state *o, struct ngc_device *dev)
 {
+	if (o->g[NGC_M4] != 0 && o->ctx.notes != NULL &&
+	    !ngc_notes_flush (o->ctx.notes, dev))
+		return 0;
+
 	switch (o->g[NGC_M4]) {
 	case NGC_M0000:
 		return ngc_device_stop (dev, 0);
@@ -508,9 +1043,46 @@ static int ngc_exec_stop (struct ngc_state *o, struct ngc_device *dev)
 	return 1;
 }
 
+/*
+ * Block done: move the current point to the block end point and apply
+ * modal codes set by the block to the current modal state. Coordinate
+ * data of G10 and offsets of G92.x are not points, probe moves the point
+ * on completion. Axes set explicitly are not waited for anymore.
+ */
+static int ngc_exec_commit (struct ngc_state *o)
+{
+	double *pos = o->var + NGC_POS_X;
+	int i;
+
+	switch (o->g[NGC_G0]) {
+	case NGC_G0100: case NGC_G0921: case NGC_G0922: case NGC_G0923:
+		break;
+	default:
+		if ((o->map & NGC_AXIS) == 0 ||
+		    ngc_modal (o, NGC_G1) == NGC_G0382)
+			break;
+
+		o->var[NGC_WAIT_AXES] = (long) o->var[NGC_WAIT_AXES] &
+					~(o->map & NGC_AXIS);
+
+		for (i = 0; i < NGC_AXES; ++i)
+			pos[i] = o->var[NGC_REL] ? pos[i] + o->axis[i] :
+				 o->g[NGC_G0] == NGC_G0530 ?
+				 o->axis[i] - o->var[NGC_ORIGIN_X + i] :
+				 o->axis[i];
+	}
+
+	for (i = 0; i < NGC_GSIZE; ++i)
+		if (i != NGC_G0 && i != NGC_M4 && o->g[i] != 0)
+			o->var[NGC_MODAL + i] = o->g[i];
+
+	return 1;
+}
+
 int ngc_exec (struct ngc_state *o, struct ngc_device *dev)
 {
-	return	ngc_exec_comment			(o, dev) &&
+	return	ngc_exec_mark				(o, dev) &&
+		ngc_exec_comment			(o, dev) &&
 		ngc_exec_set_feed_rate_mode		(o, dev) &&
 		ngc_exec_set_feed_rate			(o, dev) &&
 		ngc_exec_set_spindle_speed		(o, dev) &&
@@ -529,5 +1101,6 @@ int ngc_exec (struct ngc_state *o, struct ngc_device *dev)
 		ngc_exec_set_retract_mode		(o, dev) &&
 		ngc_exec_conf_offset			(o, dev) &&
 		ngc_exec_perform_motion			(o, dev) &&
-		ngc_exec_stop				(o, dev);
+		ngc_exec_stop				(o, dev) &&
+		ngc_exec_commit				(o);
 }
@@ -0,0 +1,31 @@
+/*
+ * NIST RS274/NGC Feed Normalisation
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <math.h>
+
+#include "ngc-feed.h"
+
+static int ngc_is_rotary (int axis)
+{
+	return axis >= 3 && axis < 6;  /* A, B, C */
+}
+
+double ngc_feed_length (const double *d, double arc)
+{
+	double l = arc * arc, r = 0;
+	int i;
+
+	for (i = 0; i < NGC_AXES; ++i)
+		if (ngc_is_rotary (i))
+			r += d[i] * d[i];
+		else
+			l += d[i] * d[i];
+
+	return sqrt (l > 0 ? l : r);
+}
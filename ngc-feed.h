@@ -0,0 +1,27 @@
+/*
+ * NIST RS274/NGC Feed Normalisation
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_FEED_H
+#define NGC_FEED_H  1
+
+#include "ngc-device.h"
+
+/*
+ * Feed normalisation: path length, duration and feed rate in units per
+ * minute of motion segments for both feed rate modes. The path length
+ * is the length of linear axes motion if any of them moves, and of
+ * rotary axes motion else (2.1.2.5). For arcs, the distances along the
+ * plane axes are zero and the arc length in the plane is given.
+ *
+ * In the inverse time mode (G93) the segment takes 1/F minutes, in the
+ * units per minute mode (G94) the feed rate is F itself.
+ */
+double ngc_feed_length (const double *d, double arc);
+
+#endif  /* NGC_FEED_H */
@@ -0,0 +1,126 @@
+/*
+ * NIST RS274/NGC Program Hashing and Result Cache
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ngc-hash.h"
+
+/*
+ * MurmurHash64A by Austin Appleby, public domain
+ */
+uint64_t ngc_hash (const void *data, size_t len, uint64_t seed)
+{
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const unsigned char *p = data, *end = p + (len & ~(size_t) 7);
+	uint64_t h = seed ^ (len * m), k;
+	int i;
+
+	for (; p < end; p += 8) {
+		memcpy (&k, p, 8);
+
+		k *= m;
+		k ^= k >> 47;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+	}
+
+	if ((len & 7) != 0) {
+		for (i = (len & 7) - 1; i >= 0; --i)
+			h ^= (uint64_t) p[i] << (i * 8);
+
+		h *= m;
+	}
+
+	h ^= h >> 47;
+	h *= m;
+	h ^= h >> 47;
+	return h;
+}
+
+static char *ngc_cache_path (const char *dir, uint64_t key, const char *suffix)
+{
+	size_t size = strlen (dir) + strlen (suffix) + 18;
+	char *path;
+
+	if ((path = malloc (size)) != NULL)
+		snprintf (path, size, "%s/%016llx%s", dir,
+			  (unsigned long long) key, suffix);
+	return path;
+}
+
+void *ngc_cache_get (const char *dir, uint64_t key, size_t *size)
+{
+	char *path, *data = NULL;
+	FILE *f;
+	long len;
+
+	if ((path = ngc_cache_path (dir, key, "")) == NULL)
+		return NULL;
+
+	if ((f = fopen (path, "rb")) == NULL)
+		goto no_file;
+
+	if (fseek (f, 0, SEEK_END) != 0 || (len = ftell (f)) < 0 ||
+	    fseek (f, 0, SEEK_SET) != 0)
+		goto no_data;
+
+	if ((data = malloc (len > 0 ? len : 1)) == NULL)
+		goto no_data;
+
+	if (fread (data, 1, len, f) != len) {
+		free (data);
+		data = NULL;
+		goto no_data;
+	}
+
+	*size = len;
+no_data:
+	fclose (f);
+no_file:
+	free (path);
+	return data;
+}
+
+int ngc_cache_put (const char *dir, uint64_t key, const void *data,
+		   size_t size)
+{
+	char *path, *temp;
+	FILE *f;
+	int fd, ok = 0;
+
+	if ((path = ngc_cache_path (dir, key, "")) == NULL)
+		return 0;
+
+	if ((temp = ngc_cache_path (dir, key, ".XXXXXX")) == NULL)
+		goto no_temp;
+
+	if ((fd = mkstemp (temp)) == -1)
+		goto no_file;
+
+	if ((f = fdopen (fd, "wb")) == NULL) {
+		close (fd);
+		unlink (temp);
+		goto no_file;
+	}
+
+	ok = fwrite (data, 1, size, f) == size;
+	ok = (fclose (f) == 0) && ok && rename (temp, path) == 0;
+
+	if (!ok)
+		unlink (temp);
+no_file:
+	free (temp);
+no_temp:
+	free (path);
+	return ok;
+}
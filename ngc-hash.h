@@ -0,0 +1,30 @@
+/*
+ * NIST RS274/NGC Program Hashing and Result Cache
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_HASH_H
+#define NGC_HASH_H  1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Fast non-cryptographic 64-bit hash, the seed allows to chain hashes of
+ * consecutive chunks
+ */
+uint64_t ngc_hash (const void *data, size_t len, uint64_t seed);
+
+/*
+ * Persistent cache of opaque entries in the directory, one file per key.
+ * Entries are replaced atomically. The get function returns allocated
+ * copy of entry or NULL if there is no such entry.
+ */
+void *ngc_cache_get (const char *dir, uint64_t key, size_t *size);
+int   ngc_cache_put (const char *dir, uint64_t key, const void *data,
+		     size_t size);
+
+#endif  /* NGC_HASH_H */
@@ -0,0 +1,696 @@
+/*
+ * NIST RS274/NGC Tool Path Index
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ngc-index.h"
+
+#define NGC_INDEX_LEAF	4	/* segments per leaf			*/
+#define NGC_INDEX_STACK	64	/* traversal stack, tree depth < 33	*/
+#define NGC_INDEX_CHUNK	4096	/* minimal segments per thread		*/
+
+struct ngc_index_head {
+	char magic[8];
+	uint64_t count, nodes;		/* segments and tree nodes	*/
+};
+
+/*
+ * Leaf has no right child and holds the range of the segment order,
+ * the left child of an inner node follows it
+ */
+struct ngc_node {
+	double lo[3], hi[3];
+	uint32_t first, count;
+	uint32_t right, pad;
+};
+
+struct ngc_index {
+	char *base;
+	size_t size;
+	int mapped;
+
+	size_t count;
+	struct ngc_node *node;
+	uint32_t *order;
+	struct ngc_seg *seg;
+};
+
+static size_t ngc_index_nodes (size_t n)
+{
+	return n <= NGC_INDEX_LEAF ? 1 :
+	       1 + ngc_index_nodes (n / 2) + ngc_index_nodes (n - n / 2);
+}
+
+/*
+ * Header, nodes, order and segments, returns the index size
+ */
+static size_t ngc_index_layout (struct ngc_index *o, size_t count)
+{
+	const size_t nodes = ngc_index_nodes (count);
+	const size_t order = sizeof (struct ngc_index_head) +
+			     nodes * sizeof (o->node[0]);
+	const size_t seg = (order + count * sizeof (o->order[0]) + 7) & ~7ul;
+
+	o->count = count;
+
+	if (o->base != NULL) {
+		o->node  = (void *) (o->base + sizeof (struct ngc_index_head));
+		o->order = (void *) (o->base + order);
+		o->seg   = (void *) (o->base + seg);
+	}
+
+	return seg + count * sizeof (o->seg[0]);
+}
+
+/*
+ * Parallel build: segment ranges are given to threads, subtrees of the
+ * few top levels are built by threads as well
+ */
+struct ngc_key {
+	uint64_t key;
+	uint32_t index;
+};
+
+struct ngc_build {
+	const struct ngc_seg *seg;
+	struct ngc_key *key, *tmp;
+	struct ngc_index *o;
+	double lo[3], scale[3];		/* key space			*/
+};
+
+struct ngc_job {
+	struct ngc_build *b;
+	size_t from, mid, to;
+	double lo[3], hi[3];
+	pthread_t tid;
+};
+
+static void ngc_index_spread (void *(*fn) (void *), struct ngc_job *job,
+			      size_t count)
+{
+	size_t i, started;
+
+	for (started = 1; started < count; ++started)
+		if (pthread_create (&job[started].tid, NULL, fn,
+				    job + started) != 0)
+			break;
+
+	for (i = started; i < count; ++i)
+		fn (job + i);
+
+	fn (job);
+
+	for (i = 1; i < started; ++i)
+		pthread_join (job[i].tid, NULL);
+}
+
+static void ngc_box_add (double *lo, double *hi, const double *p)
+{
+	int i;
+
+	for (i = 0; i < 3; ++i) {
+		if (p[i] < lo[i])	lo[i] = p[i];
+		if (p[i] > hi[i])	hi[i] = p[i];
+	}
+}
+
+static void ngc_box_reset (double *lo, double *hi)
+{
+	int i;
+
+	for (i = 0; i < 3; ++i) {
+		lo[i] =  INFINITY;
+		hi[i] = -INFINITY;
+	}
+}
+
+static void ngc_seg_center (const struct ngc_seg *s, double *c)
+{
+	int i;
+
+	for (i = 0; i < 3; ++i)
+		c[i] = (s->lo[i] + s->hi[i]) / 2;
+}
+
+static void *ngc_index_bound (void *cookie)
+{
+	struct ngc_job *j = cookie;
+	double c[3];
+	size_t i;
+
+	ngc_box_reset (j->lo, j->hi);
+
+	for (i = j->from; i < j->to; ++i) {
+		ngc_seg_center (j->b->seg + i, c);
+		ngc_box_add (j->lo, j->hi, c);
+	}
+
+	return NULL;
+}
+
+/*
+ * Morton code: 21 bits of every coordinate interleaved
+ */
+static uint64_t ngc_spread (uint64_t x)
+{
+	x &= 0x1fffff;
+	x = (x | x << 32) & 0x1f00000000ffff;
+	x = (x | x << 16) & 0x1f0000ff0000ff;
+	x = (x | x << 8)  & 0x100f00f00f00f00f;
+	x = (x | x << 4)  & 0x10c30c30c30c30c3;
+	x = (x | x << 2)  & 0x1249249249249249;
+	return x;
+}
+
+static int ngc_key_cmp (const void *a, const void *b)
+{
+	const struct ngc_key *x = a, *y = b;
+
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+
+	return (x->index > y->index) - (x->index < y->index);
+}
+
+static void *ngc_index_keys (void *cookie)
+{
+	struct ngc_job *j = cookie;
+	struct ngc_build *b = j->b;
+	uint64_t key;
+	double c[3];
+	size_t i;
+	int k;
+
+	for (i = j->from; i < j->to; ++i) {
+		ngc_seg_center (b->seg + i, c);
+
+		for (k = 0, key = 0; k < 3; ++k)
+			key |= ngc_spread ((c[k] - b->lo[k]) * b->scale[k]) << k;
+
+		b->key[i].key   = key;
+		b->key[i].index = i;
+	}
+
+	qsort (b->key + j->from, j->to - j->from, sizeof (b->key[0]),
+	       ngc_key_cmp);
+	return NULL;
+}
+
+static void *ngc_index_merge (void *cookie)
+{
+	struct ngc_job *j = cookie;
+	struct ngc_key *key = j->b->key, *to = j->b->tmp + j->from;
+	size_t a = j->from, b = j->mid;
+
+	while (a < j->mid && b < j->to)
+		*to++ = ngc_key_cmp (key + a, key + b) <= 0 ? key[a++] :
+							      key[b++];
+	while (a < j->mid)
+		*to++ = key[a++];
+
+	while (b < j->to)
+		*to++ = key[b++];
+
+	return NULL;
+}
+
+/*
+ * Sorted chunks of step keys are merged pairwise until one is left
+ */
+static void ngc_index_sort (struct ngc_build *b, struct ngc_job *job,
+			    size_t step, size_t n)
+{
+	struct ngc_key *t;
+	size_t i, jobs;
+
+	for (; step < n; step *= 2) {
+		for (i = 0, jobs = 0; i < n; i += 2 * step, ++jobs) {
+			job[jobs].b    = b;
+			job[jobs].from = i;
+			job[jobs].mid  = i + step < n ? i + step : n;
+			job[jobs].to   = i + 2 * step < n ? i + 2 * step : n;
+		}
+
+		ngc_index_spread (ngc_index_merge, job, jobs);
+
+		t = b->key, b->key = b->tmp, b->tmp = t;
+	}
+}
+
+struct ngc_tree {
+	struct ngc_build *b;
+	size_t node, first, count;
+	int depth;			/* levels to build in parallel	*/
+};
+
+static void ngc_node_add (struct ngc_node *n, const double *lo,
+			  const double *hi)
+{
+	ngc_box_add (n->lo, n->hi, lo);
+	ngc_box_add (n->lo, n->hi, hi);
+}
+
+static void *ngc_index_tree (void *cookie)
+{
+	struct ngc_tree *t = cookie, l, r;
+	struct ngc_index *o = t->b->o;
+	struct ngc_node *n = o->node + t->node;
+	const struct ngc_seg *s;
+	pthread_t tid;
+	size_t i;
+	int spawn;
+
+	ngc_box_reset (n->lo, n->hi);
+	n->first = t->first;
+	n->count = t->count;
+	n->right = n->pad = 0;
+
+	if (t->count <= NGC_INDEX_LEAF) {
+		for (i = t->first; i < t->first + t->count; ++i) {
+			s = o->seg + o->order[i];
+			ngc_node_add (n, s->lo, s->hi);
+		}
+
+		return NULL;
+	}
+
+	l.b = r.b = t->b;
+	l.depth = r.depth = t->depth - 1;
+
+	l.node  = t->node + 1;
+	l.first = t->first;
+	l.count = t->count / 2;
+
+	r.node  = l.node + ngc_index_nodes (l.count);
+	r.first = t->first + l.count;
+	r.count = t->count - l.count;
+
+	n->right = r.node;
+
+	spawn = t->depth > 0 &&
+		pthread_create (&tid, NULL, ngc_index_tree, &l) == 0;
+
+	if (!spawn)
+		ngc_index_tree (&l);
+
+	ngc_index_tree (&r);
+
+	if (spawn)
+		pthread_join (tid, NULL);
+
+	ngc_node_add (n, o->node[l.node].lo, o->node[l.node].hi);
+	ngc_node_add (n, o->node[r.node].lo, o->node[r.node].hi);
+	return NULL;
+}
+
+static int ngc_index_run (struct ngc_build *b, size_t n, int threads)
+{
+	struct ngc_tree t = { b, 0, 0, n, 0 };
+	size_t count, step, i;
+	struct ngc_job *job;
+	int k;
+
+	count = n / NGC_INDEX_CHUNK < (size_t) threads ?
+		n / NGC_INDEX_CHUNK + 1 : (size_t) threads;
+	step  = (n + count - 1) / count;
+
+	if ((job = calloc (count, sizeof (job[0]))) == NULL)
+		return 0;
+
+	for (i = 0; i < count; ++i) {
+		job[i].b    = b;
+		job[i].from = i * step < n ? i * step : n;
+		job[i].to   = (i + 1) * step < n ? (i + 1) * step : n;
+	}
+
+	ngc_index_spread (ngc_index_bound, job, count);
+
+	for (i = 1; i < count; ++i) {
+		ngc_box_add (job[0].lo, job[0].hi, job[i].lo);
+		ngc_box_add (job[0].lo, job[0].hi, job[i].hi);
+	}
+
+	for (k = 0; k < 3; ++k) {
+		const double size = job[0].hi[k] - job[0].lo[k];
+
+		b->lo[k]    = job[0].lo[k];
+		b->scale[k] = size > 0 ? 0x1fffff / size : 0;
+	}
+
+	ngc_index_spread (ngc_index_keys, job, count);
+	ngc_index_sort (b, job, step, n);
+
+	for (i = 0; i < n; ++i)
+		b->o->order[i] = b->key[i].index;
+
+	for (t.depth = 0; (1 << t.depth) < threads; ++t.depth) {}
+
+	ngc_index_tree (&t);
+	free (job);
+	return 1;
+}
+
+struct ngc_index *ngc_index_build (const struct ngc_toolpath *tp, int threads)
+{
+	const size_t n = tp->count;
+	struct ngc_build b = { .seg = tp->seg };
+	struct ngc_index *o;
+	struct ngc_index_head *h;
+	int ok;
+
+	if (n > UINT32_MAX) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (threads <= 0 && (threads = sysconf (_SC_NPROCESSORS_ONLN)) <= 0)
+		threads = 1;
+
+	if ((o = calloc (1, sizeof (*o))) == NULL)
+		return NULL;
+
+	o->size = ngc_index_layout (o, n);
+
+	if ((o->base = calloc (1, o->size)) == NULL)
+		goto no_base;
+
+	ngc_index_layout (o, n);
+
+	h = (void *) o->base;
+	memcpy (h->magic, NGC_INDEX_MAGIC, sizeof (NGC_INDEX_MAGIC));
+	h->count = n;
+	h->nodes = ngc_index_nodes (n);
+
+	if (n > 0)
+		memcpy (o->seg, tp->seg, n * sizeof (o->seg[0]));
+
+	b.o = o;
+
+	ok = (b.key = malloc (n * sizeof (b.key[0]) + 1)) != NULL &&
+	     (b.tmp = malloc (n * sizeof (b.tmp[0]) + 1)) != NULL &&
+	     ngc_index_run (&b, n, threads);
+
+	free (b.tmp);
+	free (b.key);
+
+	if (ok)
+		return o;
+
+	free (o->base);
+no_base:
+	free (o);
+	return NULL;
+}
+
+/*
+ * Tree of a loaded index must have the shape build gives it: traversal
+ * relies on the depth bound and on leaf ranges within the order. Returns
+ * the node following the subtree, or zero if the subtree is broken.
+ */
+static size_t ngc_index_check (const struct ngc_index *o, size_t nodes,
+			       size_t node, size_t first, size_t count)
+{
+	const struct ngc_node *n = o->node + node;
+	size_t next;
+
+	if (node >= nodes || n->first != first || n->count != count)
+		return 0;
+
+	if (count <= NGC_INDEX_LEAF)
+		return n->right == 0 ? node + 1 : 0;
+
+	next = ngc_index_check (o, nodes, node + 1, first, count / 2);
+
+	if (next == 0 || n->right != next)
+		return 0;
+
+	return ngc_index_check (o, nodes, next, first + count / 2,
+				count - count / 2);
+}
+
+static int ngc_index_valid (const struct ngc_index *o, size_t nodes)
+{
+	const struct ngc_seg *s;
+	size_t i;
+
+	if (ngc_index_check (o, nodes, 0, 0, o->count) != nodes)
+		return 0;
+
+	for (i = 0; i < o->count; ++i)
+		if (o->order[i] >= o->count)
+			return 0;
+
+	for (i = 0, s = o->seg; i < o->count; ++i, ++s)
+		if (s->type < NGC_SEG_MOVE || s->type > NGC_SEG_ARC ||
+		    (s->type == NGC_SEG_ARC &&
+		     (s->a < 0 || s->a > 2 || s->b < 0 || s->b > 2 ||
+		      s->a == s->b)))
+			return 0;
+
+	return 1;
+}
+
+struct ngc_index *ngc_index_load (const char *path)
+{
+	struct ngc_index_head h;
+	struct ngc_index *o;
+	struct stat st;
+	void *p;
+	int fd;
+
+	if ((o = calloc (1, sizeof (*o))) == NULL)
+		return NULL;
+
+	if ((fd = open (path, O_RDONLY | O_CLOEXEC)) == -1)
+		goto no_file;
+
+	if (fstat (fd, &st) != 0 || (size_t) st.st_size < sizeof (h))
+		goto broken;
+
+	p = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if (p == MAP_FAILED)
+		goto no_map;
+
+	memcpy (&h, p, sizeof (h));
+
+	/*
+	 * Every segment takes more space than its order entry and node
+	 * share, thus the size bounds the count before the layout (and
+	 * the node count walk) is computed from it
+	 */
+	if (memcmp (h.magic, NGC_INDEX_MAGIC, sizeof (NGC_INDEX_MAGIC)) != 0 ||
+	    h.count > UINT32_MAX ||
+	    h.count > (st.st_size - sizeof (h)) / sizeof (o->seg[0]) ||
+	    h.nodes != ngc_index_nodes (h.count) ||
+	    (size_t) st.st_size != ngc_index_layout (o, h.count))
+		goto unmap;
+
+	o->base   = p;
+	o->size   = st.st_size;
+	o->mapped = 1;
+	ngc_index_layout (o, h.count);
+
+	if (!ngc_index_valid (o, h.nodes))
+		goto unmap;
+
+	close (fd);
+	return o;
+unmap:
+	munmap (p, st.st_size);
+broken:
+	errno = EINVAL;
+no_map:
+	close (fd);
+no_file:
+	free (o);
+	return NULL;
+}
+
+int ngc_index_save (const struct ngc_index *o, const char *path)
+{
+	const char *p = o->base;
+	size_t left = o->size;
+	ssize_t len;
+	char *temp;
+	int fd, ok;
+
+	if ((temp = malloc (strlen (path) + 8)) == NULL)
+		return 0;
+
+	strcpy (temp, path);
+	strcat (temp, ".XXXXXX");
+
+	if ((fd = mkstemp (temp)) == -1) {
+		free (temp);
+		return 0;
+	}
+
+	(void) fchmod (fd, 0644);
+
+	while (left > 0)
+		if ((len = write (fd, p, left)) > 0)
+			p += len, left -= len;
+		else if (errno != EINTR)
+			break;
+
+	ok = left == 0 && fsync (fd) == 0;
+	ok = close (fd) == 0 && ok && rename (temp, path) == 0;
+
+	if (!ok)
+		unlink (temp);
+
+	free (temp);
+	return ok;
+}
+
+void ngc_index_free (struct ngc_index *o)
+{
+	if (o == NULL)
+		return;
+
+	if (o->mapped)
+		munmap (o->base, o->size);
+	else
+		free (o->base);
+
+	free (o);
+}
+
+size_t ngc_index_count (const struct ngc_index *o)
+{
+	return o->count;
+}
+
+const struct ngc_seg *ngc_index_seg (const struct ngc_index *o, size_t i)
+{
+	return i < o->count ? o->seg + i : NULL;
+}
+
+/*
+ * Queries
+ */
+static int ngc_box_overlap (const double *alo, const double *ahi,
+			    const double *blo, const double *bhi)
+{
+	return	alo[0] <= bhi[0] && blo[0] <= ahi[0] &&
+		alo[1] <= bhi[1] && blo[1] <= ahi[1] &&
+		alo[2] <= bhi[2] && blo[2] <= ahi[2];
+}
+
+size_t ngc_index_region (const struct ngc_index *o,
+			 const double *lo, const double *hi,
+			 size_t *seg, size_t size)
+{
+	size_t stack[NGC_INDEX_STACK], top = 0, found = 0, i;
+	const struct ngc_node *n;
+	const struct ngc_seg *s;
+
+	if (o->count > 0)
+		stack[top++] = 0;
+
+	while (top > 0) {
+		n = o->node + stack[--top];
+
+		if (!ngc_box_overlap (n->lo, n->hi, lo, hi))
+			continue;
+
+		if (n->right != 0) {
+			stack[top++] = n->right;
+			stack[top++] = n - o->node + 1;
+			continue;
+		}
+
+		for (i = n->first; i < n->first + n->count; ++i) {
+			s = o->seg + o->order[i];
+
+			if (!ngc_box_overlap (s->lo, s->hi, lo, hi))
+				continue;
+
+			if (found < size)
+				seg[found] = o->order[i];
+
+			++found;
+		}
+	}
+
+	return found;
+}
+
+static double ngc_box_dist (const struct ngc_node *n, const double *p)
+{
+	double d, sum = 0;
+	int i;
+
+	for (i = 0; i < 3; ++i) {
+		d = p[i] < n->lo[i] ? n->lo[i] - p[i] :
+		    p[i] > n->hi[i] ? p[i] - n->hi[i] : 0;
+		sum += d * d;
+	}
+
+	return sqrt (sum);
+}
+
+/*
+ * Depth-first search, the nearer child is visited first and subtrees
+ * farther than the best segment found so far are skipped
+ */
+long ngc_index_nearest (const struct ngc_index *o, const double *p,
+			double *dist)
+{
+	size_t stack[NGC_INDEX_STACK], top = 0, i, l, r;
+	const struct ngc_node *n;
+	double best = INFINITY, d;
+	long found = -1;
+
+	if (o->count > 0)
+		stack[top++] = 0;
+
+	while (top > 0) {
+		n = o->node + stack[--top];
+
+		if (ngc_box_dist (n, p) >= best)
+			continue;
+
+		if (n->right != 0) {
+			l = n - o->node + 1;
+			r = n->right;
+
+			if (ngc_box_dist (o->node + l, p) <=
+			    ngc_box_dist (o->node + r, p))
+				stack[top++] = r, stack[top++] = l;
+			else
+				stack[top++] = l, stack[top++] = r;
+
+			continue;
+		}
+
+		for (i = n->first; i < n->first + n->count; ++i)
+			if ((d = ngc_seg_dist (o->seg + o->order[i], p)) < best) {
+				best  = d;
+				found = o->order[i];
+			}
+	}
+
+	if (dist != NULL)
+		*dist = best;
+
+	return found;
+}
@@ -0,0 +1,56 @@
+/*
+ * NIST RS274/NGC Tool Path Index
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_INDEX_H
+#define NGC_INDEX_H  1
+
+#include <stddef.h>
+
+#include "ngc-toolpath.h"
+
+#define NGC_INDEX_MAGIC		"NGCI\3"
+
+/*
+ * Bounding volume hierarchy over boxes of tool path segments: segments
+ * are ordered along the Morton curve of their box centers and the order
+ * is split in halves recursively down to leaves of a few segments. Key
+ * computation, sorting and subtrees are spread over threads (zero means
+ * the number of online processors). The result does not depend on the
+ * number of threads.
+ *
+ * The index is a single block with the same layout in memory and in the
+ * file, thus a saved index is mapped and used in place. Data is stored
+ * in host byte order. Save replaces the file atomically. Load checks the
+ * size, the tree shape and the ranges of the mapped file and fails with
+ * EINVAL if they differ from what build makes.
+ */
+struct ngc_index *ngc_index_build (const struct ngc_toolpath *tp, int threads);
+struct ngc_index *ngc_index_load  (const char *path);
+int  ngc_index_save (const struct ngc_index *o, const char *path);
+void ngc_index_free (struct ngc_index *o);
+
+/*
+ * Segments are numbered as in the tool path the index built from
+ */
+size_t ngc_index_count (const struct ngc_index *o);
+const struct ngc_seg *ngc_index_seg (const struct ngc_index *o, size_t i);
+
+/*
+ * Region query stores numbers of segments which boxes intersect the box
+ * lo-hi into seg (up to size of them) and returns the number of such
+ * segments. Nearest query returns the number of the segment nearest to
+ * the point and the distance to it, or -1 if the index is empty.
+ */
+size_t ngc_index_region  (const struct ngc_index *o,
+			  const double *lo, const double *hi,
+			  size_t *seg, size_t size);
+long   ngc_index_nearest (const struct ngc_index *o, const double *p,
+			  double *dist);
+
+#endif  /* NGC_INDEX_H */
@@ -0,0 +1,191 @@
+/*
+ * NIST RS274/NGC Program Input
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/wait.h>
+
+#include "ngc-input.h"
+
+#ifndef NGC_INPUT_BIN
+#define NGC_INPUT_BIN	"/usr/bin/"	/* decompressors directory	*/
+#endif
+
+struct ngc_input {
+	int fd;
+	pid_t pid;
+};
+
+static const struct ngc_format {
+	const char *magic;
+	size_t len;
+	const char *tool;
+} ngc_formats[] = {
+	{ "\x1f\x8b",		2, NGC_INPUT_BIN "gzip"  },
+	{ "BZh",		3, NGC_INPUT_BIN "bzip2" },
+	{ "\xfd" "7zXZ",	6, NGC_INPUT_BIN "xz"    },
+	{ "\x28\xb5\x2f\xfd",	4, NGC_INPUT_BIN "zstd"  },
+};
+
+static const struct ngc_format *ngc_input_format (int fd)
+{
+	const size_t count = sizeof (ngc_formats) / sizeof (ngc_formats[0]);
+	char head[6];
+	ssize_t len = pread (fd, head, sizeof (head), 0);
+	size_t i;
+
+	for (i = 0; i < count; ++i)
+		if (len >= (ssize_t) ngc_formats[i].len &&
+		    memcmp (head, ngc_formats[i].magic, ngc_formats[i].len) == 0)
+			return ngc_formats + i;
+
+	return NULL;
+}
+
+int ngc_input_is_packed (const char *path)
+{
+	int fd, packed;
+
+	if ((fd = open (path, O_RDONLY | O_CLOEXEC)) == -1)
+		return 0;
+
+	packed = ngc_input_format (fd) != NULL;
+	close (fd);
+	return packed;
+}
+
+static ssize_t ngc_input_read (void *cookie, char *buf, size_t size)
+{
+	struct ngc_input *o = cookie;
+
+	return read (o->fd, buf, size);
+}
+
+static int ngc_input_close (void *cookie)
+{
+	struct ngc_input *o = cookie;
+	int status = 0;
+
+	close (o->fd);  /* helper gets SIGPIPE if it is still running */
+
+	while (waitpid (o->pid, &status, 0) == -1 && errno == EINTR) {}
+
+	free (o);
+
+	if (WIFEXITED (status) && WEXITSTATUS (status) == 0)
+		return 0;
+
+	if (WIFSIGNALED (status) && WTERMSIG (status) == SIGPIPE)
+		return 0;  /* reader closed stream before end */
+
+	errno = EIO;
+	return -1;
+}
+
+/*
+ * The helper must die on SIGPIPE when the reader closes the stream early
+ * and must not hold descriptors of the caller (client connections of a
+ * service, say), thus signal disposition and mask are reset and
+ * descriptors other than standard ones are closed. The caller could be
+ * multithreaded, thus nothing runs between fork and exec but the spawn
+ * actions, and the helper is run by its full path, not searched in PATH.
+ */
+static pid_t ngc_input_spawn (const char *tool, int in, int out)
+{
+	char *const argv[] = { (char *) tool, "-dc", NULL };
+	posix_spawn_file_actions_t fa;
+	posix_spawnattr_t sa;
+	sigset_t none, pipe;
+	pid_t pid;
+	int error;
+
+	sigemptyset (&none);
+	sigemptyset (&pipe);
+	sigaddset (&pipe, SIGPIPE);
+
+	posix_spawn_file_actions_init (&fa);
+	posix_spawn_file_actions_adddup2 (&fa, in,  0);
+	posix_spawn_file_actions_adddup2 (&fa, out, 1);
+	posix_spawn_file_actions_addclosefrom_np (&fa, 3);
+
+	posix_spawnattr_init (&sa);
+	posix_spawnattr_setsigdefault (&sa, &pipe);
+	posix_spawnattr_setsigmask (&sa, &none);
+	posix_spawnattr_setflags (&sa, POSIX_SPAWN_SETSIGDEF |
+				       POSIX_SPAWN_SETSIGMASK);
+
+	error = posix_spawn (&pid, tool, &fa, &sa, argv, environ);
+
+	posix_spawnattr_destroy (&sa);
+	posix_spawn_file_actions_destroy (&fa);
+
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+
+	return pid;
+}
+
+FILE *ngc_input_open (const char *path)
+{
+	static const cookie_io_functions_t io = {
+		.read	= ngc_input_read,
+		.close	= ngc_input_close,
+	};
+	const struct ngc_format *fmt;
+	struct ngc_input *o;
+	int fd, pipefd[2];
+	FILE *f;
+
+	if ((fd = open (path, O_RDONLY | O_CLOEXEC)) == -1)
+		return NULL;
+
+	if ((fmt = ngc_input_format (fd)) == NULL) {
+		if ((f = fdopen (fd, "r")) == NULL)
+			close (fd);
+
+		return f;
+	}
+
+	if ((o = malloc (sizeof (*o))) == NULL)
+		goto no_input;
+
+	if (pipe2 (pipefd, O_CLOEXEC) != 0)
+		goto no_pipe;
+
+	if ((o->pid = ngc_input_spawn (fmt->tool, fd, pipefd[1])) == -1)
+		goto no_spawn;
+
+	close (pipefd[1]);
+	close (fd);
+
+	o->fd = pipefd[0];
+
+	if ((f = fopencookie (o, "r", io)) == NULL)
+		ngc_input_close (o);
+
+	return f;
+no_spawn:
+	close (pipefd[0]);
+	close (pipefd[1]);
+no_pipe:
+	free (o);
+no_input:
+	close (fd);
+	return NULL;
+}
@@ -0,0 +1,34 @@
+/*
+ * NIST RS274/NGC Program Input
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_INPUT_H
+#define NGC_INPUT_H  1
+
+#include <stdio.h>
+
+/*
+ * Open program for reading. Compressed programs (gzip, bzip2, xz, zstd)
+ * are decompressed on the fly by a helper process through a pipe, so
+ * only a pipe buffer worth of text is in memory at once and no temporary
+ * files are used. The stream is closed with fclose as usual, it fails if
+ * decompression failed.
+ *
+ * The helper is a decompressor process (gzip, bzip2, xz or zstd from
+ * NGC_INPUT_BIN), not a thread of the caller. The stream is built with
+ * fopencookie and the helper is spawned with closefrom file action, thus
+ * this is Linux (glibc 2.34 or later) only.
+ */
+FILE *ngc_input_open (const char *path);
+
+/*
+ * Returns non-zero if the program file is compressed
+ */
+int ngc_input_is_packed (const char *path);
+
+#endif  /* NGC_INPUT_H */
@@ -0,0 +1,176 @@
+/*
+ * NIST RS274/NGC Tool Path Locator
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ngc-index.h"
+#include "ngc-sim.h"
+#include "ngc-state.h"
+
+static int build (const char *program, const char *path, int threads)
+{
+	struct ngc_toolpath tp = {};
+	struct ngc_state o = {};
+	struct ngc_device *dev;
+	struct ngc_index *index = NULL;
+	FILE *in;
+	int ok;
+
+	if ((in = fopen (program, "r")) == NULL) {
+		perror ("ngc-locate: cannot open program");
+		return 0;
+	}
+
+	if ((o.var = calloc (NGC_VSIZE, sizeof (o.var[0]))) == NULL ||
+	    (dev = ngc_device_alloc ("sim")) == NULL) {
+		perror ("ngc-locate");
+		fclose (in);
+		return 0;
+	}
+
+	ngc_state_reset (&o);
+	ngc_sim_toolpath (dev, &tp);
+
+	if (!(ok = ngc_run (&o, in, dev)))
+		;  /* reported by interpreter */
+	else if (!(ok = (index = ngc_index_build (&tp, threads)) != NULL))
+		perror ("ngc-locate: cannot build index");
+	else if (!(ok = ngc_index_save (index, path)))
+		perror ("ngc-locate: cannot save index");
+
+	ngc_index_free (index);
+	ngc_toolpath_fini (&tp);
+	ngc_device_free (dev);
+	free (o.var);
+	fclose (in);
+	return ok;
+}
+
+static int cmp (const void *a, const void *b)
+{
+	long x = *(const long *) a, y = *(const long *) b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * Print block lines of the segments in the box, every line once
+ */
+static int region (struct ngc_index *o, const double *box)
+{
+	size_t count = ngc_index_region (o, box, box + 3, NULL, 0), i;
+	size_t *seg;
+	long *line;
+
+	if ((seg  = malloc (count * sizeof (seg[0])  + 1)) == NULL ||
+	    (line = malloc (count * sizeof (line[0]) + 1)) == NULL) {
+		free (seg);
+		return 0;
+	}
+
+	ngc_index_region (o, box, box + 3, seg, count);
+
+	for (i = 0; i < count; ++i)
+		line[i] = ngc_index_seg (o, seg[i])->line;
+
+	qsort (line, count, sizeof (line[0]), cmp);
+
+	for (i = 0; i < count; ++i)
+		if (i == 0 || line[i] != line[i - 1])
+			printf ("%ld\n", line[i]);
+
+	free (line);
+	free (seg);
+	return 1;
+}
+
+static int nearest (struct ngc_index *o, const double *p)
+{
+	double dist;
+	long i;
+
+	if ((i = ngc_index_nearest (o, p, &dist)) < 0)
+		return 0;
+
+	printf ("%ld %g\n", ngc_index_seg (o, i)->line, dist);
+	return 1;
+}
+
+static int read_vec (const char *s, double *v, int count)
+{
+	char *end;
+	int i;
+
+	for (i = 0; i < count; ++i, s = end + 1) {
+		v[i] = strtod (s, &end);
+
+		if (end == s || *end != (i + 1 < count ? ',' : '\0'))
+			return 0;
+	}
+
+	return 1;
+}
+
+int main (int argc, char *argv[])
+{
+	struct ngc_index *o;
+	double v[6];
+	int opt, mode = 0, threads = 0, ok;
+
+	while ((opt = getopt (argc, argv, "bj:r:n:")) != -1)
+		switch (opt) {
+		case 'b':
+			mode = opt;
+			break;
+		case 'j':
+			threads = atoi (optarg);
+			break;
+		case 'r':
+			mode = opt;
+
+			if (!read_vec (optarg, v, 6))
+				goto usage;
+
+			break;
+		case 'n':
+			mode = opt;
+
+			if (!read_vec (optarg, v, 3))
+				goto usage;
+
+			break;
+		default:
+			goto usage;
+		}
+
+	if (mode == 'b')
+		return argc == optind + 2 &&
+		       build (argv[optind], argv[optind + 1], threads) ? 0 : 1;
+
+	if (mode == 0 || argc != optind + 1)
+		goto usage;
+
+	if ((o = ngc_index_load (argv[optind])) == NULL) {
+		perror ("ngc-locate: cannot load index");
+		return 1;
+	}
+
+	ok = mode == 'r' ? region (o, v) : nearest (o, v);
+
+	ngc_index_free (o);
+	return ok ? 0 : 1;
+usage:
+	fprintf (stderr, "usage:\n"
+			 "\tngc-locate -b [-j threads] program.ngc index\n"
+			 "\tngc-locate -r x0,y0,z0,x1,y1,z1 index\n"
+			 "\tngc-locate -n x,y,z index\n");
+	return 1;
+}
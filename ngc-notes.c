@@ -0,0 +1,186 @@
+/*
+ * NIST RS274/NGC Comment Channel
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ngc-hash.h"
+#include "ngc-notes.h"
+
+#define NGC_NOTES_BATCH	64	/* comments delivered at once		*/
+#define NGC_CHUNK_SIZE	4096	/* pool chunk size			*/
+
+/*
+ * Pool texts are stored in chunks that are never moved, the index is an
+ * open addressing hash table of texts.
+ */
+struct ngc_chunk {
+	struct ngc_chunk *next;
+	size_t used, size;
+	char data[];
+};
+
+struct ngc_slot {
+	uint64_t hash;
+	const char *text;
+};
+
+struct ngc_notes {
+	struct ngc_chunk *chunk;
+	struct ngc_slot *slot;
+	size_t size, count;			/* index size and fill	*/
+
+	struct ngc_note batch[NGC_NOTES_BATCH];
+	size_t pending;
+};
+
+struct ngc_notes *ngc_notes_alloc (void)
+{
+	return calloc (1, sizeof (struct ngc_notes));
+}
+
+void ngc_notes_free (struct ngc_notes *o)
+{
+	struct ngc_chunk *c, *next;
+
+	if (o == NULL)
+		return;
+
+	for (c = o->chunk; c != NULL; c = next) {
+		next = c->next;
+		free (c);
+	}
+
+	free (o->slot);
+	free (o);
+}
+
+static char *ngc_notes_store (struct ngc_notes *o, const char *s, size_t len)
+{
+	struct ngc_chunk *c = o->chunk;
+	size_t size;
+	char *p;
+
+	if (c == NULL || c->size - c->used <= len) {
+		size = len < NGC_CHUNK_SIZE ? NGC_CHUNK_SIZE : len + 1;
+
+		if ((c = malloc (sizeof (*c) + size)) == NULL)
+			return NULL;
+
+		c->next = o->chunk;
+		c->used = 0;
+		c->size = size;
+		o->chunk = c;
+	}
+
+	p = c->data + c->used;
+	memcpy (p, s, len + 1);
+	c->used += len + 1;
+	return p;
+}
+
+static int ngc_notes_grow (struct ngc_notes *o)
+{
+	const size_t size = o->size == 0 ? 64 : o->size * 2;
+	struct ngc_slot *slot;
+	size_t i, j;
+
+	if ((slot = calloc (size, sizeof (slot[0]))) == NULL)
+		return 0;
+
+	for (i = 0; i < o->size; ++i)
+		if (o->slot[i].text != NULL) {
+			for (j = o->slot[i].hash; slot[j % size].text != NULL; ++j) {}
+
+			slot[j % size] = o->slot[i];
+		}
+
+	free (o->slot);
+	o->slot = slot;
+	o->size = size;
+	return 1;
+}
+
+const char *ngc_notes_intern (struct ngc_notes *o, const char *s)
+{
+	const size_t len = strlen (s);
+	const uint64_t hash = ngc_hash (s, len, 0);
+	struct ngc_slot *e;
+	size_t i;
+
+	if (o->count * 2 >= o->size && !ngc_notes_grow (o))
+		return NULL;
+
+	for (i = hash;; ++i) {
+		e = o->slot + i % o->size;
+
+		if (e->text == NULL)
+			break;
+
+		if (e->hash == hash && strcmp (e->text, s) == 0)
+			return e->text;
+	}
+
+	if ((e->text = ngc_notes_store (o, s, len)) == NULL)
+		return NULL;
+
+	e->hash = hash;
+	++o->count;
+	return e->text;
+}
+
+static int ngc_note_is_message (int type)
+{
+	return type == NGC_NOTE_MSG || type == NGC_NOTE_DEBUG;
+}
+
+int ngc_note_send (struct ngc_device *dev, int type, const char *text)
+{
+	if (ngc_note_is_message (type))
+		return ngc_device_message (dev, text);
+
+	return ngc_device_comment (dev, text);
+}
+
+/*
+ * Messages are for the operator, thus they are not held back: the batch
+ * is flushed and the message is delivered at once, before the motions
+ * of the block
+ */
+int ngc_notes_post (struct ngc_notes *o, struct ngc_device *dev,
+		    int type, long line, const char *text)
+{
+	struct ngc_note *n;
+
+	if (ngc_note_is_message (type))
+		return ngc_notes_flush (o, dev) &&
+		       ngc_note_send (dev, type, text);
+
+	if (o->pending == NGC_NOTES_BATCH && !ngc_notes_flush (o, dev))
+		return 0;
+
+	n = o->batch + o->pending++;
+	n->type = type;
+	n->line = line;
+	n->text = text;
+	return 1;
+}
+
+int ngc_notes_flush (struct ngc_notes *o, struct ngc_device *dev)
+{
+	size_t i;
+	int ok = 1;
+
+	for (i = 0; i < o->pending; ++i)
+		ok &= ngc_note_send (dev, o->batch[i].type, o->batch[i].text);
+
+	o->pending = 0;
+	return ok;
+}
@@ -0,0 +1,61 @@
+/*
+ * NIST RS274/NGC Comment Channel
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_NOTES_H
+#define NGC_NOTES_H  1
+
+#include <stddef.h>
+
+#include "ngc-device.h"
+
+/*
+ * Comment types, comments are classified once by the parser and the
+ * type prefix is stripped from the text
+ */
+enum ngc_note_type {
+	NGC_NOTE_COMMENT,	/* plain comment			*/
+	NGC_NOTE_MSG,		/* (MSG, text): operator message	*/
+	NGC_NOTE_DEBUG,		/* (DEBUG, text)		(EMC2)	*/
+	NGC_NOTE_PRINT,		/* (PRINT, text)		(EMC2)	*/
+};
+
+struct ngc_note {
+	int type;
+	long line;			/* source line number		*/
+	const char *text;		/* interned text		*/
+};
+
+/*
+ * Comment channel: a string pool and a batch of posted comments. The
+ * parser interns comment texts into the pool, thus equal comments are
+ * stored once and stay valid until the channel is freed. The executor
+ * posts comments into the batch without calling the device, the batch
+ * is delivered to the device on flush or when it is full.
+ *
+ * Messages and debug messages are delivered as device messages, plain
+ * comments and print messages as device comments. Messages are not
+ * batched: posting one flushes the batch and delivers the message at
+ * once, thus the operator sees it before the motions of its block and
+ * after all comments posted earlier. Plain comments and print messages
+ * may be delivered after the motions that follow them, but before the
+ * next message or stop (the executor flushes on M0, M1, M2, M30, M60)
+ * and in program order.
+ */
+struct ngc_notes *ngc_notes_alloc (void);
+void ngc_notes_free (struct ngc_notes *o);
+
+const char *ngc_notes_intern (struct ngc_notes *o, const char *s);
+
+int ngc_notes_post  (struct ngc_notes *o, struct ngc_device *dev,
+		     int type, long line, const char *text);
+int ngc_notes_flush (struct ngc_notes *o, struct ngc_device *dev);
+
+int ngc_note_send (struct ngc_device *dev, int type, const char *text);
+
+#endif  /* NGC_NOTES_H */
@@ -0,0 +1,457 @@
+/*
+ * NIST RS274/NGC Program Packer
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ngc-sim.h"
+#include "ngc-state.h"
+
+/*
+ * Every block is parsed, checked and executed into the simulation
+ * device, then it is written back in the minimal form:
+ *
+ *  - expressions and parameter references are replaced by values, thus
+ *    settings of parameters below 5061 are dropped, other settings are
+ *    kept as they are seen by the machine;
+ *  - codes of modal groups that repeat the current code are dropped,
+ *    stop and tool change codes are always kept;
+ *  - in G0 and G1 straight motion axis words that do not move the axis
+ *    are dropped, as well as F and S words that repeat the current feed
+ *    rate (units per minute mode only) and spindle speed;
+ *  - the machine state at program start is unknown, thus a code or a
+ *    word is dropped only if it was written before;
+ *  - line numbers, spaces and empty blocks are dropped, comments are
+ *    dropped optionally (messages are kept).
+ *
+ * Words are written in alphabetical order after the G-codes and before
+ * the M-codes, numbers are rounded to the given number of decimal places
+ * with trailing zeros removed. In incremental mode (G91) the rounding
+ * error of an axis word of a motion is carried into the next word of
+ * the axis (a word rounded to zero is dropped and carried whole), thus
+ * the written path stays within half of the last digit of the original
+ * one. The output depends on the input and the options only, thus it is
+ * reproducible byte by byte.
+ */
+static const char *gname[] = {
+	[NGC_G0040] = "G4",	[NGC_G0100] = "G10",	[NGC_G0280] = "G28",
+	[NGC_G0300] = "G30",	[NGC_G0530] = "G53",	[NGC_G0920] = "G92",
+	[NGC_G0921] = "G92.1",	[NGC_G0922] = "G92.2",	[NGC_G0923] = "G92.3",
+
+	[NGC_G0000] = "G0",	[NGC_G0010] = "G1",	[NGC_G0020] = "G2",
+	[NGC_G0030] = "G3",	[NGC_G0382] = "G38.2",	[NGC_G0800] = "G80",
+	[NGC_G0810] = "G81",	[NGC_G0820] = "G82",	[NGC_G0830] = "G83",
+	[NGC_G0840] = "G84",	[NGC_G0850] = "G85",	[NGC_G0860] = "G86",
+	[NGC_G0870] = "G87",	[NGC_G0880] = "G88",	[NGC_G0890] = "G89",
+
+	[NGC_G0170] = "G17",	[NGC_G0180] = "G18",	[NGC_G0190] = "G19",
+	[NGC_G0900] = "G90",	[NGC_G0910] = "G91",
+	[NGC_G0930] = "G93",	[NGC_G0940] = "G94",
+	[NGC_G0200] = "G20",	[NGC_G0210] = "G21",
+	[NGC_G0400] = "G40",	[NGC_G0410] = "G41",	[NGC_G0420] = "G42",
+	[NGC_G0430] = "G43",	[NGC_G0490] = "G49",
+	[NGC_G0980] = "G98",	[NGC_G0990] = "G99",
+
+	[NGC_G0540] = "G54",	[NGC_G0550] = "G55",	[NGC_G0560] = "G56",
+	[NGC_G0570] = "G57",	[NGC_G0580] = "G58",	[NGC_G0590] = "G59",
+	[NGC_G0591] = "G59.1",	[NGC_G0592] = "G59.2",	[NGC_G0593] = "G59.3",
+
+	[NGC_G0610] = "G61",	[NGC_G0611] = "G61.1",	[NGC_G0640] = "G64",
+};
+
+static const char *mname[] = {
+	[NGC_M0000] = "M0",	[NGC_M0010] = "M1",	[NGC_M0020] = "M2",
+	[NGC_M0300] = "M30",	[NGC_M0600] = "M60",	[NGC_M0060] = "M6",
+	[NGC_M0030] = "M3",	[NGC_M0040] = "M4",	[NGC_M0050] = "M5",
+	[NGC_M0070] = "M7",	[NGC_M0080] = "M8",	[NGC_M0090] = "M9",
+	[NGC_M0480] = "M48",	[NGC_M0490] = "M49",
+};
+
+static const char *note_prefix[] = {
+	[NGC_NOTE_COMMENT]	= "",
+	[NGC_NOTE_MSG]		= "MSG,",
+	[NGC_NOTE_DEBUG]	= "DEBUG,",
+	[NGC_NOTE_PRINT]	= "PRINT,",
+};
+
+#define NUM_SIZE	330	/* fixed point double with 9 decimal places	*/
+
+struct pack {
+	FILE *out;
+	int prec;
+	double scale;			/* 10 ^ prec			*/
+	size_t count;			/* items written on the line	*/
+	unsigned modal;			/* modal groups written		*/
+	long known;			/* axes, F and S written	*/
+	double var[NGC_REL - NGC_PROBE_X];
+	double word[26];		/* words to write		*/
+	double carry[NGC_AXES];		/* G91 rounding error		*/
+};
+
+static void put (struct pack *o, const char *s)
+{
+	fputs (s, o->out);
+	++o->count;
+}
+
+/*
+ * Numbers are rounded to fixed point integers and printed without stdio,
+ * huge ones (never seen in programs) are printed with printf
+ */
+static int fixed (struct pack *o, double v, long long *n)
+{
+	const double x = v * o->scale;
+
+	if (!(fabs (x) < 1e15))
+		return 0;
+
+	*n = llround (x);
+	return 1;
+}
+
+static const char *fmt_slow (struct pack *o, char *buf, double v)
+{
+	char *p;
+
+	snprintf (buf, NUM_SIZE, "%.*f", o->prec, v);
+
+	if (strchr (buf, '.') != NULL) {
+		for (p = buf + strlen (buf) - 1; *p == '0'; --p) {}
+
+		p[*p == '.' ? 0 : 1] = '\0';
+	}
+
+	return strcmp (buf, "-0") == 0 ? "0" : buf;
+}
+
+static const char *fmt (struct pack *o, char *buf, double v)
+{
+	char frac[16], digit[24], *p = buf;
+	unsigned long long u;
+	long long n;
+	int i, len, count = 0;
+
+	if (!fixed (o, v, &n))
+		return fmt_slow (o, buf, v);
+
+	u = n < 0 ? -(unsigned long long) n : n;
+
+	for (i = o->prec, len = 0; i > 0; --i, u /= 10)
+		if ((frac[i - 1] = '0' + u % 10) != '0' && len == 0)
+			len = i;
+
+	do
+		digit[count++] = '0' + u % 10;
+	while ((u /= 10) != 0);
+
+	if (n < 0)
+		*p++ = '-';
+
+	while (count > 0)
+		*p++ = digit[--count];
+
+	if (len > 0) {
+		*p++ = '.';
+		memcpy (p, frac, len);
+		p += len;
+	}
+
+	*p = '\0';
+	return buf;
+}
+
+static int same (struct pack *o, double a, double b)
+{
+	char x[NUM_SIZE], y[NUM_SIZE];
+	long long m, n;
+
+	if (fixed (o, a, &m) && fixed (o, b, &n))
+		return m == n;
+
+	return strcmp (fmt (o, x, a), fmt (o, y, b)) == 0;
+}
+
+static void put_word (struct pack *o, int c, double v)
+{
+	char buf[NUM_SIZE];
+
+	putc (c, o->out);
+	put (o, fmt (o, buf, v));
+}
+
+/*
+ * Incremental motion axis words take the rounding error left by the
+ * previous ones, the error is reset by absolute mode
+ */
+static void carry_words (struct ngc_state *b, struct pack *o)
+{
+	const int motion = ngc_modal (b, NGC_G1);
+	long long n;
+	double v;
+	int i, w;
+
+	memcpy (o->word, b->word, sizeof (o->word));
+
+	if (ngc_modal (b, NGC_G3) != NGC_G0910) {
+		memset (o->carry, 0, sizeof (o->carry));
+		return;
+	}
+
+	if (motion < NGC_G0000 || motion > NGC_G0030 || b->g[NGC_G0] != 0)
+		return;
+
+	for (i = 0; i < NGC_AXES; ++i) {
+		w = "XYZABCUVW"[i] - 'A';
+
+		if ((b->map & (1L << w)) == 0)
+			continue;
+
+		if (!fixed (o, v = b->word[w] + o->carry[i], &n)) {
+			o->carry[i] = 0;
+			continue;
+		}
+
+		o->word[w]  = v;
+		o->carry[i] = v - n / o->scale;
+	}
+}
+
+/*
+ * Modal codes are compared with the current modal state, that is, with
+ * the state before the block is executed. G53 requires motion code on
+ * the same line.
+ */
+static int is_new_code (struct ngc_state *b, struct pack *o, int group)
+{
+	switch (group) {
+	case NGC_G0:
+	case NGC_M4:
+	case NGC_M6:
+		return 1;
+	case NGC_G1:
+		if (b->g[NGC_G0] == NGC_G0530)
+			return 1;
+	}
+
+	return (o->modal & (1u << group)) == 0 ||
+	       b->g[group] != b->var[NGC_MODAL + group];
+}
+
+static void put_codes (struct ngc_state *b, struct pack *o, int m)
+{
+	int i;
+
+	for (i = 0; i < NGC_GSIZE; ++i)
+		if ((i >= NGC_M4) == m && b->g[i] != 0 &&
+		    is_new_code (b, o, i)) {
+			put (o, m ? mname[b->g[i]] : gname[b->g[i]]);
+			o->modal |= 1u << i;
+		}
+}
+
+/*
+ * Returns words that could be dropped: axes of straight motion that
+ * does not change the origin, coordinate or time base. Axes are kept
+ * all if the block sets the motion mode, since the motion code alone is
+ * a motion without axis words.
+ */
+static long get_optional (struct ngc_state *b, struct pack *o)
+{
+	const int motion = ngc_modal (b, NGC_G1);
+	const int rel = ngc_modal (b, NGC_G3) == NGC_G0910;
+	long map = 0;
+	int i;
+
+	if (ngc_modal (b, NGC_G5) != NGC_G0930) {
+		if ((b->map & NGC_F) != 0 &&
+		    same (o, ngc_word (b, 'F'), b->var[NGC_FEED]))
+			map |= NGC_F;
+	}
+
+	if ((b->map & NGC_S) != 0 &&
+	    same (o, ngc_word (b, 'S'), b->var[NGC_SPEED]))
+		map |= NGC_S;
+
+	if ((motion != NGC_G0000 && motion != NGC_G0010) ||
+	    (b->g[NGC_G1] != 0 && is_new_code (b, o, NGC_G1)) ||
+	    ngc_modal (b, NGC_G5) == NGC_G0930 || ngc_is_comp_mode (b) ||
+	    b->g[NGC_G0] != 0 || b->g[NGC_G6] != 0 || b->g[NGC_G7] != 0 ||
+	    b->g[NGC_G8] != 0 || b->g[NGC_G12] != 0 || b->var[NGC_DIRTY])
+		return map;
+
+	for (i = 0; i < NGC_AXES; ++i) {
+		const int c = "XYZABCUVW"[i];
+		const long mask = 1L << (c - 'A');
+
+		if ((b->map & mask) == 0 ||
+		    ((long) b->var[NGC_WAIT_AXES] & mask) != 0)
+			continue;
+
+		if (same (o, o->word[c - 'A'], rel ? 0 : b->var[NGC_POS_X + i]))
+			map |= mask;
+	}
+
+	return map;
+}
+
+static void put_words (struct ngc_state *b, struct pack *o)
+{
+	const long known = o->known;
+	const long map = b->map & ~(get_optional (b, o) & known) & ~NGC_N;
+	int i;
+
+	o->known |= b->map & (NGC_F | NGC_S);
+
+	if (ngc_modal (b, NGC_G3) == NGC_G0900 && b->g[NGC_G0] == 0)
+		o->known |= b->map & NGC_AXIS;
+
+	for (i = 0; i < 26; ++i)
+		if ((map & (1L << i)) != 0)
+			put_word (o, 'A' + i, o->word[i]);
+}
+
+static void put_settings (struct ngc_state *b, struct pack *o)
+{
+	char buf[NUM_SIZE];
+	size_t i;
+
+	for (i = 0; i < NGC_REL - NGC_PROBE_X; ++i)
+		if (b->var[NGC_PROBE_X + i] != o->var[i]) {
+			fprintf (o->out, "#%zu=", NGC_PROBE_X + i);
+			put (o, fmt (o, buf, b->var[NGC_PROBE_X + i]));
+		}
+}
+
+static void put_comment (struct ngc_state *b, struct pack *o)
+{
+	const char *p = b->comment;
+
+	if (p == NULL)
+		return;
+
+	if (strpbrk (p, "()") == NULL)
+		fprintf (o->out, "(%s%s)", note_prefix[b->comment_type], p);
+	else
+		fprintf (o->out, ";%s%s", note_prefix[b->comment_type], p);
+
+	++o->count;
+}
+
+/*
+ * Parameter settings take effect after the line is read, settings of
+ * the machine parameters are found by comparison with the saved ones
+ */
+static int pack_block (struct ngc_state *b, char *line, struct pack *o,
+		       struct ngc_device *dev)
+{
+	const unsigned sys = NGC_VC_ALL & ~NGC_VC_USER & ~NGC_VC_POS;
+	int set;
+
+	if (!ngc_scan (b, line) || !ngc_sync (b, dev, 0))
+		return 0;
+
+	if ((set = (b->deps.writes & sys) != 0))
+		memcpy (o->var, b->var + NGC_PROBE_X, sizeof (o->var));
+
+	if (!ngc_parse (b, line) || !ngc_check (b) || !ngc_deps (b) ||
+	    !ngc_sync (b, dev, 0))
+		return 0;
+
+	o->count = 0;
+
+	carry_words (b, o);
+	put_codes (b, o, 0);
+	put_words (b, o);
+	put_codes (b, o, 1);
+
+	if (set)
+		put_settings (b, o);
+
+	put_comment (b, o);
+
+	if (o->count > 0)
+		putc ('\n', o->out);
+
+	return ngc_exec (b, dev);
+}
+
+static int pack (struct ngc_state *init, FILE *in, struct pack *o,
+		 struct ngc_device *dev)
+{
+	struct ngc_ring r;
+	struct ngc_state *cur;
+	char *line = NULL;
+	size_t size = 0;
+	int ok = 1;
+
+	if (!ngc_ring_init (&r, 2, init))
+		return ngc_error (init, "%s", strerror (errno));
+
+	for (cur = r.slot; ok && getline (&line, &size, in) > 0;) {
+		cur = ngc_ring_next (&r);
+		ok  = pack_block (cur, line, o, dev);
+
+		if (cur->prev == NULL)  /* program end */
+			break;
+	}
+
+	free (line);
+	ngc_ring_fini (&r);
+	return ok && !ferror (in) && fflush (o->out) == 0;
+}
+
+int main (int argc, char *argv[])
+{
+	struct pack o = { .out = stdout, .prec = 4 };
+	struct ngc_state s = {};
+	struct ngc_device *dev;
+	FILE *in = stdin;
+	int opt, quiet = 0, ok;
+
+	while ((opt = getopt (argc, argv, "cp:")) != -1)
+		switch (opt) {
+		case 'c':	quiet = 1; break;
+		case 'p':	o.prec = atoi (optarg); break;
+		default:	goto usage;
+		}
+
+	if (argc > optind + 1 || o.prec < 0 || o.prec > 9)
+		goto usage;
+
+	o.scale = pow (10, o.prec);
+
+	if (argc == optind + 1 && (in = fopen (argv[optind], "r")) == NULL) {
+		perror ("ngc-pack: cannot open program");
+		return 1;
+	}
+
+	if ((s.var = calloc (NGC_VSIZE, sizeof (s.var[0]))) == NULL ||
+	    (dev = ngc_device_alloc ("sim")) == NULL) {
+		perror ("ngc-pack");
+		return 1;
+	}
+
+	ngc_state_reset (&s);
+	s.var[NGC_NO_COMMENTS] = quiet;
+
+	ok = pack (&s, in, &o, dev);
+
+	ngc_device_free (dev);
+	free (s.var);
+	fclose (in);
+	return ok ? 0 : 1;
+usage:
+	fprintf (stderr, "usage:\n\tngc-pack [-c] [-p precision] "
+			 "[program.ngc]\n");
+	return 1;
+}
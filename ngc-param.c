@@ -0,0 +1,194 @@
+/*
+ * NIST RS274/NGC Parameter File
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ngc-param.h"
+
+#define NGC_PARAM_COUNT	(NGC_PARAM_LAST - NGC_PARAM_FIRST + 1)
+
+struct ngc_param_head {
+	char magic[8];
+	uint32_t first, count;
+};
+
+int ngc_param_load (double *var, const char *path)
+{
+	struct ngc_param_head h;
+	struct stat st;
+	void *p;
+	int fd, ok = 0;
+
+	if ((fd = open (path, O_RDONLY | O_CLOEXEC)) == -1)
+		return 0;
+
+	if (fstat (fd, &st) != 0 || (size_t) st.st_size < sizeof (h))
+		goto broken;
+
+	p = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if (p == MAP_FAILED)
+		goto out;
+
+	memcpy (&h, p, sizeof (h));
+
+	if (memcmp (h.magic, NGC_PARAM_MAGIC, sizeof (NGC_PARAM_MAGIC)) != 0 ||
+	    h.first < NGC_PARAM_FIRST || h.first > NGC_PARAM_LAST ||
+	    h.count > NGC_PARAM_LAST + 1 - h.first ||
+	    (size_t) st.st_size != sizeof (h) + h.count * sizeof (var[0])) {
+		munmap (p, st.st_size);
+		goto broken;
+	}
+
+	memcpy (var + h.first, (char *) p + sizeof (h),
+		h.count * sizeof (var[0]));
+	munmap (p, st.st_size);
+
+	var[NGC_DIRTY] = 1;
+	ok = 1;
+	goto out;
+broken:
+	errno = EINVAL;
+out:
+	close (fd);
+	return ok;
+}
+
+/*
+ * Open temporary file next to the target, returns its descriptor and
+ * name to rename it to the target when done
+ */
+static int ngc_param_temp (const char *path, char **temp)
+{
+	int fd;
+
+	if ((*temp = malloc (strlen (path) + 8)) == NULL)
+		return -1;
+
+	strcpy (*temp, path);
+	strcat (*temp, ".XXXXXX");
+
+	if ((fd = mkstemp (*temp)) == -1)
+		free (*temp);
+	else
+		(void) fchmod (fd, 0644);
+
+	return fd;
+}
+
+static int ngc_param_commit (FILE *f, char *temp, const char *path)
+{
+	int ok;
+
+	ok = fflush (f) == 0 && fsync (fileno (f)) == 0;
+	ok = fclose (f) == 0 && ok && rename (temp, path) == 0;
+
+	if (!ok)
+		unlink (temp);
+
+	free (temp);
+	return ok;
+}
+
+int ngc_param_save (const double *var, const char *path)
+{
+	struct ngc_param_head h = {
+		.magic = NGC_PARAM_MAGIC,
+		.first = NGC_PARAM_FIRST, .count = NGC_PARAM_COUNT,
+	};
+	char *temp;
+	FILE *f;
+	int fd;
+
+	if ((fd = ngc_param_temp (path, &temp)) == -1)
+		return 0;
+
+	if ((f = fdopen (fd, "wb")) == NULL) {
+		close (fd);
+		unlink (temp);
+		free (temp);
+		return 0;
+	}
+
+	fwrite (&h, sizeof (h), 1, f);
+	fwrite (var + h.first, sizeof (var[0]), h.count, f);
+
+	return ngc_param_commit (f, temp, path);
+}
+
+int ngc_param_import (double *var, const char *path)
+{
+	char *line = NULL, *p, *end;
+	size_t size = 0;
+	long index;
+	double value;
+	FILE *f;
+	int ok = 1;
+
+	if ((f = fopen (path, "r")) == NULL)
+		return 0;
+
+	while (ok && getline (&line, &size, f) > 0) {
+		index = strtol (line, &p, 10);
+
+		if (p == line) {
+			ok = strspn (line, " \t\r\n") == strlen (line);
+			continue;  /* empty line */
+		}
+
+		value = strtod (p, &end);
+		ok = end != p && index > 0 && index < NGC_REL &&
+		     strspn (end, " \t\r\n") == strlen (end);
+
+		if (ok)
+			var[index] = value;
+	}
+
+	if (!ok)
+		errno = EINVAL;
+
+	ok = ok && !ferror (f);
+
+	free (line);
+	fclose (f);
+
+	var[NGC_DIRTY] = 1;
+	return ok;
+}
+
+int ngc_param_export (const double *var, const char *path)
+{
+	char *temp;
+	FILE *f;
+	int fd, i;
+
+	if ((fd = ngc_param_temp (path, &temp)) == -1)
+		return 0;
+
+	if ((f = fdopen (fd, "w")) == NULL) {
+		close (fd);
+		unlink (temp);
+		free (temp);
+		return 0;
+	}
+
+	for (i = NGC_PARAM_FIRST; i <= NGC_PARAM_LAST; ++i)
+		fprintf (f, "%d\t%.6f\n", i, var[i]);
+
+	return ngc_param_commit (f, temp, path);
+}
@@ -0,0 +1,46 @@
+/*
+ * NIST RS274/NGC Parameter File
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_PARAM_H
+#define NGC_PARAM_H  1
+
+#include "ngc-vars.h"
+
+/*
+ * Persistent parameters: G28 and G30 home positions, G92 offsets and
+ * coordinate systems, 5161-5390
+ */
+#define NGC_PARAM_FIRST	NGC_HOME_X
+#define NGC_PARAM_LAST	NGC_CS9_R
+
+/*
+ * Binary parameter image: a header (magic, index of the first parameter
+ * and the number of parameters) followed by parameter values in host
+ * byte order. The image is mapped on load and copied into the parameter
+ * store as is. Save writes a temporary file next to the target and
+ * renames it over the target, thus the image is replaced atomically.
+ *
+ * Load accepts images of persistent parameters only and marks program
+ * origin to be recomposed.
+ */
+#define NGC_PARAM_MAGIC	"NGCP\1"
+
+int ngc_param_load (double *var, const char *path);
+int ngc_param_save (const double *var, const char *path);
+
+/*
+ * Text parameter file in the classic .var format: a parameter number and
+ * its value per line. Import accepts any parameter visible to programs,
+ * parameters before a broken line are imported still. Export writes
+ * persistent parameters (atomically as save does).
+ */
+int ngc_param_import (double *var, const char *path);
+int ngc_param_export (const double *var, const char *path);
+
+#endif  /* NGC_PARAM_H */
@@ -0,0 +1,410 @@
+/*
+ * NIST RS274/NGC Block Parser
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ngc-state.h"
+
+#define NGC_ASSIGN_MAX	50	/* parameter settings per line		*/
+#define NGC_NEST_MAX	16	/* nested parameter references		*/
+
+static char *ngc_skip (char *p)
+{
+	while (*p == ' ' || *p == '\t')
+		++p;
+
+	return p;
+}
+
+static int ngc_set_code (struct ngc_state *o, int group, int code, int type)
+{
+	if (o->g[group] != 0)
+		return ngc_error (o, "Two %c-codes used from the same modal "
+				     "group", type);
+	o->g[group] = code;
+	return 1;
+}
+
+static int ngc_parse_gcode (struct ngc_state *o, double v)
+{
+	const int n = lround (v * 10);
+
+	if (fabs (v * 10 - n) > 0.0001)
+		return ngc_error (o, "Unknown G-code G%g", v);
+
+	switch (n) {
+	case   0: return ngc_set_code (o, NGC_G1,  NGC_G0000, 'G');
+	case  10: return ngc_set_code (o, NGC_G1,  NGC_G0010, 'G');
+	case  20: return ngc_set_code (o, NGC_G1,  NGC_G0020, 'G');
+	case  30: return ngc_set_code (o, NGC_G1,  NGC_G0030, 'G');
+	case  40: return ngc_set_code (o, NGC_G0,  NGC_G0040, 'G');
+#if NGC_HAS_G10
+	case 100: return ngc_set_code (o, NGC_G0,  NGC_G0100, 'G');
+#endif
+	case 170: return ngc_set_code (o, NGC_G2,  NGC_G0170, 'G');
+	case 180: return ngc_set_code (o, NGC_G2,  NGC_G0180, 'G');
+	case 190: return ngc_set_code (o, NGC_G2,  NGC_G0190, 'G');
+	case 200: return ngc_set_code (o, NGC_G6,  NGC_G0200, 'G');
+	case 210: return ngc_set_code (o, NGC_G6,  NGC_G0210, 'G');
+	case 280: return ngc_set_code (o, NGC_G0,  NGC_G0280, 'G');
+	case 300: return ngc_set_code (o, NGC_G0,  NGC_G0300, 'G');
+	case 382: return ngc_set_code (o, NGC_G1,  NGC_G0382, 'G');
+	case 400: return ngc_set_code (o, NGC_G7,  NGC_G0400, 'G');
+#if NGC_HAS_COMP
+	case 410: return ngc_set_code (o, NGC_G7,  NGC_G0410, 'G');
+	case 420: return ngc_set_code (o, NGC_G7,  NGC_G0420, 'G');
+#endif
+	case 430: return ngc_set_code (o, NGC_G8,  NGC_G0430, 'G');
+	case 490: return ngc_set_code (o, NGC_G8,  NGC_G0490, 'G');
+	case 530: return ngc_set_code (o, NGC_G0,  NGC_G0530, 'G');
+	case 540: return ngc_set_code (o, NGC_G12, NGC_G0540, 'G');
+	case 550: return ngc_set_code (o, NGC_G12, NGC_G0550, 'G');
+	case 560: return ngc_set_code (o, NGC_G12, NGC_G0560, 'G');
+	case 570: return ngc_set_code (o, NGC_G12, NGC_G0570, 'G');
+	case 580: return ngc_set_code (o, NGC_G12, NGC_G0580, 'G');
+	case 590: return ngc_set_code (o, NGC_G12, NGC_G0590, 'G');
+	case 591: return ngc_set_code (o, NGC_G12, NGC_G0591, 'G');
+	case 592: return ngc_set_code (o, NGC_G12, NGC_G0592, 'G');
+	case 593: return ngc_set_code (o, NGC_G12, NGC_G0593, 'G');
+	case 610: return ngc_set_code (o, NGC_G13, NGC_G0610, 'G');
+	case 611: return ngc_set_code (o, NGC_G13, NGC_G0611, 'G');
+	case 640: return ngc_set_code (o, NGC_G13, NGC_G0640, 'G');
+	case 800: return ngc_set_code (o, NGC_G1,  NGC_G0800, 'G');
+#if NGC_HAS_CYCLES
+	case 810: return ngc_set_code (o, NGC_G1,  NGC_G0810, 'G');
+	case 820: return ngc_set_code (o, NGC_G1,  NGC_G0820, 'G');
+	case 830: return ngc_set_code (o, NGC_G1,  NGC_G0830, 'G');
+	case 840: return ngc_set_code (o, NGC_G1,  NGC_G0840, 'G');
+	case 850: return ngc_set_code (o, NGC_G1,  NGC_G0850, 'G');
+	case 860: return ngc_set_code (o, NGC_G1,  NGC_G0860, 'G');
+	case 870: return ngc_set_code (o, NGC_G1,  NGC_G0870, 'G');
+	case 880: return ngc_set_code (o, NGC_G1,  NGC_G0880, 'G');
+	case 890: return ngc_set_code (o, NGC_G1,  NGC_G0890, 'G');
+#endif
+	case 900: return ngc_set_code (o, NGC_G3,  NGC_G0900, 'G');
+	case 910: return ngc_set_code (o, NGC_G3,  NGC_G0910, 'G');
+	case 920: return ngc_set_code (o, NGC_G0,  NGC_G0920, 'G');
+	case 921: return ngc_set_code (o, NGC_G0,  NGC_G0921, 'G');
+	case 922: return ngc_set_code (o, NGC_G0,  NGC_G0922, 'G');
+	case 923: return ngc_set_code (o, NGC_G0,  NGC_G0923, 'G');
+	case 930: return ngc_set_code (o, NGC_G5,  NGC_G0930, 'G');
+	case 940: return ngc_set_code (o, NGC_G5,  NGC_G0940, 'G');
+	case 980: return ngc_set_code (o, NGC_G10, NGC_G0980, 'G');
+	case 990: return ngc_set_code (o, NGC_G10, NGC_G0990, 'G');
+	}
+
+	return ngc_error (o, "Unknown G-code G%g", v);
+}
+
+static int ngc_parse_mcode (struct ngc_state *o, double v)
+{
+	const int n = lround (v);
+
+	if (fabs (v - n) > 0.0001)
+		return ngc_error (o, "Unknown M-code M%g", v);
+
+	switch (n) {
+	case  0: return ngc_set_code (o, NGC_M4, NGC_M0000, 'M');
+	case  1: return ngc_set_code (o, NGC_M4, NGC_M0010, 'M');
+	case  2: return ngc_set_code (o, NGC_M4, NGC_M0020, 'M');
+	case  3: return ngc_set_code (o, NGC_M7, NGC_M0030, 'M');
+	case  4: return ngc_set_code (o, NGC_M7, NGC_M0040, 'M');
+	case  5: return ngc_set_code (o, NGC_M7, NGC_M0050, 'M');
+	case  6: return ngc_set_code (o, NGC_M6, NGC_M0060, 'M');
+	case  7: return ngc_set_code (o, NGC_M8, NGC_M0070, 'M');
+	case  8: return ngc_set_code (o, NGC_M8, NGC_M0080, 'M');
+	case  9: return ngc_set_code (o, NGC_M8, NGC_M0090, 'M');
+	case 30: return ngc_set_code (o, NGC_M4, NGC_M0300, 'M');
+	case 48: return ngc_set_code (o, NGC_M9, NGC_M0480, 'M');
+	case 49: return ngc_set_code (o, NGC_M9, NGC_M0490, 'M');
+	case 60: return ngc_set_code (o, NGC_M4, NGC_M0600, 'M');
+	}
+
+	return ngc_error (o, "Unknown M-code M%g", v);
+}
+
+static int ngc_parse_number (struct ngc_state *o, char **s, double *v)
+{
+	static const double scale[] = {
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,
+		1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+	};
+	char *p = ngc_skip (*s);
+	int neg = 0, digits = 0, frac = 0;
+	double x = 0;
+
+	if (*p == '+' || *p == '-') {
+		neg = *p == '-';
+		p = ngc_skip (p + 1);
+	}
+
+	for (; isdigit ((unsigned char) *p); p = ngc_skip (p + 1), ++digits)
+		x = x * 10 + (*p - '0');
+
+	if (*p == '.')
+		for (p = ngc_skip (p + 1); isdigit ((unsigned char) *p);
+		     p = ngc_skip (p + 1)) {
+			x = x * 10 + (*p - '0');
+			++digits, ++frac;
+		}
+
+	if (digits == 0)
+		return ngc_error (o, "Bad number format");
+
+	if (frac >= sizeof (scale) / sizeof (scale[0]))
+		return ngc_error (o, "Too many digits in number");
+
+	*v = (neg ? -x : x) / scale[frac];
+	*s = p;
+	return 1;
+}
+
+static int ngc_var_index (struct ngc_state *o, double v, int *index)
+{
+	*index = v;
+
+	if (fabs (v - *index) > 0.0001)
+		return ngc_error (o, "Parameter number must be an integer");
+
+	if (*index < 1 || *index >= NGC_REL)
+		return ngc_error (o, "Parameter number out of range");
+
+	return 1;
+}
+
+/*
+ * Nested parameter references (##n) are resolved from the innermost one
+ * in a loop, the nesting depth is limited.
+ */
+static int ngc_parse_value (struct ngc_state *o, char **s, double *v)
+{
+	char *p = ngc_skip (*s);
+	int depth, index;
+
+	for (depth = 0; *p == '#'; p = ngc_skip (p + 1))
+		if (++depth > NGC_NEST_MAX)
+			return ngc_error (o, "Parameter references nested "
+					     "too deep");
+
+	if (*p == '[')
+		return ngc_error (o, "Expressions are not supported");
+
+	*s = p;
+
+	if (!ngc_parse_number (o, s, v))
+		return 0;
+
+	for (; depth > 0; --depth) {
+		if (!ngc_var_index (o, *v, &index))
+			return 0;
+
+		*v = o->var[index];
+	}
+
+	return 1;
+}
+
+static int ngc_parse_index (struct ngc_state *o, char **s, int *index)
+{
+	double v;
+
+	return ngc_parse_value (o, s, &v) && ngc_var_index (o, v, index);
+}
+
+/*
+ * Parameters the program origin is composed from
+ */
+static int ngc_is_origin_var (int i)
+{
+	return (i >= NGC_OFFSET_ON && i <= NGC_CS9_R) ||
+	       (i >= NGC_TOOL_X    && i <= NGC_TOOL_W);
+}
+
+/*
+ * Comments are classified once here: the type prefix is stripped, plain
+ * comments are dropped if requested, and the text is interned into the
+ * comment channel if any, thus it outlives the line buffer.
+ */
+static int ngc_parse_note (struct ngc_state *o, const char *p)
+{
+	static const struct {
+		const char *prefix;
+		size_t len;
+		int type;
+	} map[] = {
+		{ "MSG,",	4, NGC_NOTE_MSG		},
+		{ "DEBUG,",	6, NGC_NOTE_DEBUG	},
+		{ "PRINT,",	6, NGC_NOTE_PRINT	},
+	};
+	size_t i;
+
+	o->comment_type = NGC_NOTE_COMMENT;
+
+	for (i = 0; i < sizeof (map) / sizeof (map[0]); ++i)
+		if (strncasecmp (p, map[i].prefix, map[i].len) == 0) {
+			o->comment_type = map[i].type;
+			p += map[i].len;
+			p += (*p == ' ');
+			break;
+		}
+
+	if (o->comment_type == NGC_NOTE_COMMENT && o->var[NGC_NO_COMMENTS]) {
+		o->comment = NULL;
+		return 1;
+	}
+
+	if (o->ctx.notes != NULL &&
+	    (p = ngc_notes_intern (o->ctx.notes, p)) == NULL)
+		return ngc_error (o, "Out of memory for comment");
+
+	o->comment = p;
+	return 1;
+}
+
+static int ngc_parse_comment (struct ngc_state *o, char **s)
+{
+	char *p, *end;
+
+	for (p = *s + 1, end = p; *end != ')'; ++end)
+		if (*end == '(')
+			return ngc_error (o, "Nested comment found");
+		else if (*end == '\0' || *end == '\n' || *end == '\r')
+			return ngc_error (o, "Unclosed comment found");
+
+	*end = '\0';
+	*s = end + 1;
+	return ngc_parse_note (o, p);
+}
+
+static int ngc_parse_word (struct ngc_state *o, char **s)
+{
+	int c = toupper ((unsigned char) **s), i = c - 'A';
+	long mask;
+	double v;
+
+	*s += 1;
+
+	/* not isupper: other upper case letters are there in some locales */
+	if (c == 'E' || c == 'O' || c < 'A' || c > 'Z')
+		return ngc_error (o, "Unknown word starting with %c", c);
+
+	mask = 1L << i;
+
+	if (!ngc_parse_value (o, s, &v))
+		return 0;
+
+	switch (c) {
+	case 'G':	return ngc_parse_gcode (o, v);
+	case 'M':	return ngc_parse_mcode (o, v);
+	}
+
+	if ((o->map & mask) != 0)
+		return ngc_error (o, "Multiple %c words on one line", c);
+
+	o->word[i] = v;
+	o->map |= mask;
+	return 1;
+}
+
+/*
+ * Length normalisation: length words of inch programs are converted to
+ * millimeters at decode time, thus the executor and the device see one
+ * unit system. These are linear axes, arc center offsets and radius,
+ * peck increment and per minute feed rate. Parameter values are taken
+ * as is.
+ */
+static const long ngc_length_words = NGC_XYZ | NGC_UVW | NGC_IJ | NGC_K |
+				     NGC_R | NGC_Q;
+
+static void ngc_parse_metric (struct ngc_state *o)
+{
+	long map = o->map & ngc_length_words;
+	int i;
+
+	if (!o->var[NGC_METRIC] || ngc_modal (o, NGC_G6) != NGC_G0200)
+		return;
+
+	if (ngc_modal (o, NGC_G5) != NGC_G0930)
+		map |= o->map & NGC_F;
+
+	for (i = 0; map != 0; ++i, map >>= 1)
+		if ((map & 1) != 0)
+			o->word[i] *= 25.4;
+}
+
+/*
+ * Parse one line of RS274/NGC program into block state. Parameter
+ * settings take effect after all parameter values on the line are read.
+ */
+int ngc_parse (struct ngc_state *o, char *line)
+{
+	int index[NGC_ASSIGN_MAX];
+	double value[NGC_ASSIGN_MAX];
+	int i, count = 0;
+	char *p = ngc_skip (line);
+
+	memset (o->g, 0, sizeof (o->g));
+	o->map = 0;
+	o->comment = NULL;
+
+	if (*p == '/' || *p == '%')  /* block delete switch is off */
+		p = ngc_skip (p + 1);
+
+	for (; *p != '\0' && *p != '\n' && *p != '\r'; p = ngc_skip (p))
+		switch (*p) {
+		case ';':
+			p[strcspn (p, "\r\n")] = '\0';
+
+			if (!ngc_parse_note (o, p + 1))
+				return 0;
+
+			goto done;
+		case '(':
+			if (!ngc_parse_comment (o, &p))
+				return 0;
+
+			break;
+		case '#':
+			if (count == NGC_ASSIGN_MAX)
+				return ngc_error (o, "Too many parameter "
+						     "settings on one line");
+			++p;
+
+			if (!ngc_parse_index (o, &p, index + count))
+				return 0;
+
+			if (*(p = ngc_skip (p)) != '=')
+				return ngc_error (o, "Equal sign missing in "
+						     "parameter setting");
+			++p;
+
+			if (!ngc_parse_value (o, &p, value + count))
+				return 0;
+
+			++count;
+			break;
+		default:
+			if (!ngc_parse_word (o, &p))
+				return 0;
+		}
+done:
+	ngc_parse_metric (o);
+
+	for (i = 0; i < count; ++i) {
+		o->var[index[i]] = value[i];
+
+		if (ngc_is_origin_var (index[i]))
+			o->var[NGC_DIRTY] = 1;
+	}
+
+	return 1;
+}
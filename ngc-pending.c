@@ -0,0 +1,99 @@
+/*
+ * NIST RS274/NGC Pending Device Operations
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "ngc-state.h"
+
+static const long ngc_axis_bit[NGC_AXES] = {
+	NGC_X, NGC_Y, NGC_Z, NGC_A, NGC_B, NGC_C, NGC_U, NGC_V, NGC_W,
+};
+
+/*
+ * Probe result sets probe parameters and moves the current point of the
+ * probed axes to the trip point unless they were set explicitly since.
+ */
+int ngc_complete (struct ngc_state *o, const struct ngc_result *r)
+{
+	long axes = o->var[NGC_WAIT_AXES];
+	double p;
+	int i;
+
+	o->var[NGC_WAIT_OPS] = (int) o->var[NGC_WAIT_OPS] & ~r->op;
+
+	switch (r->op) {
+	case NGC_OP_PROBE:
+		for (i = 0; i < NGC_AXES; ++i) {
+			p = r->pos[i];
+
+			if (o->var[NGC_MACHINE])
+				p -= o->var[NGC_ORIGIN_X + i];
+
+			o->var[NGC_PROBE_X + i] = p;
+
+			if ((axes & ngc_axis_bit[i]) != 0)
+				o->var[NGC_POS_X + i] = p;
+		}
+
+		o->var[NGC_PROBE_OK]  = r->ok;
+		o->var[NGC_WAIT_AXES] = 0;
+		return 1;
+
+	case NGC_OP_TOOL:
+		return r->ok || ngc_error (o, "Tool change failed");
+	}
+
+	return 1;
+}
+
+/*
+ * A block depends on pending operations if it reads or writes parameters
+ * written on completion (probe results and point, tool data), writes
+ * parameters read on completion (origin for probe in machine coordinates)
+ * or reads the current point of the probed axes.
+ */
+static int ngc_is_blocked (struct ngc_state *o)
+{
+	const struct ngc_deps *d = &o->deps;
+	int ops = o->var[NGC_WAIT_OPS];
+	long axes = o->var[NGC_WAIT_AXES];
+	unsigned done = 0, used = 0;
+
+	if ((ops & NGC_OP_PROBE) != 0) {
+		done |= NGC_VC_PROBE | NGC_VC_POS;
+		used |= NGC_VC_ORIGIN;
+	}
+
+	if ((ops & NGC_OP_TOOL) != 0)
+		done |= NGC_VC_TOOL;
+
+	return	(d->reads & done & ~NGC_VC_POS) != 0 ||
+		(d->writes & (done | used) & ~NGC_VC_POS) != 0 ||
+		(d->axes & axes) != 0;
+}
+
+int ngc_sync (struct ngc_state *o, struct ngc_device *dev, int all)
+{
+	struct ngc_result r;
+
+	if (o->var[NGC_WAIT_OPS] == 0)
+		return 1;
+
+	while (ngc_device_poll (dev, &r, 0))  /* take ready results */
+		if (!ngc_complete (o, &r))
+			return 0;
+
+	while (o->var[NGC_WAIT_OPS] != 0 && (all || ngc_is_blocked (o))) {
+		if (!ngc_device_poll (dev, &r, 1))
+			return ngc_error (o, "Device lost pending operation");
+
+		if (!ngc_complete (o, &r))
+			return 0;
+	}
+
+	return 1;
+}
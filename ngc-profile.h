@@ -0,0 +1,50 @@
+/*
+ * NIST RS274/NGC Interpreter Profiles
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_PROFILE_H
+#define NGC_PROFILE_H  1
+
+/*
+ * Interpreter profile is selected at compile time: NGC_PROFILE_MILL
+ * (default, full interpreter), NGC_PROFILE_LATHE or NGC_PROFILE_ROUTER.
+ * Profile defines optional features, codes of missing features are
+ * rejected by parser as unknown ones, their checks, execution and state
+ * are compiled out.
+ *
+ *	NGC_HAS_G10	set coordinate system data (G10)
+ *	NGC_HAS_COMP	cutter radius compensation (G41, G42)
+ *	NGC_HAS_CYCLES	canned cycles (G81 to G89)
+ *
+ * The parameter store layout depends on the profile, thus programs must
+ * be built with the profile macro of the library variant they use: the
+ * pkg-config file of every variant (enigma-lathe.pc, enigma-router.pc)
+ * carries it in Cflags.
+ *
+ * The lathe profile is not a lathe interpreter. Cutter compensation is
+ * implemented for the XY plane only and canned cycles drill along the
+ * plane normal (Y in the XZ plane), while lathes use nose radius
+ * compensation in the XZ plane (G18) and drill along Z. Thus both are
+ * dropped from the profile rather than done in the wrong plane, and
+ * lathe programs using them are rejected.
+ */
+#if defined (NGC_PROFILE_ROUTER)
+#define NGC_HAS_G10	0
+#define NGC_HAS_COMP	0
+#define NGC_HAS_CYCLES	0
+#elif defined (NGC_PROFILE_LATHE)
+#define NGC_HAS_G10	1
+#define NGC_HAS_COMP	0	/* implemented for XY plane only */
+#define NGC_HAS_CYCLES	0	/* drilling along the plane normal */
+#else
+#define NGC_HAS_G10	1
+#define NGC_HAS_COMP	1
+#define NGC_HAS_CYCLES	1
+#endif
+
+#endif  /* NGC_PROFILE_H */
@@ -0,0 +1,125 @@
+/*
+ * NIST RS274/NGC Command Queue
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ngc-queue.h"
+
+/*
+ * Intrusive queue with a stub node: producers swap the head and link the
+ * previous head to the new node, the consumer walks from the tail. The
+ * stub is pushed back when the last node is popped, thus the tail never
+ * becomes NULL.
+ */
+struct ngc_queue {
+	_Atomic (struct ngc_cmd *) head;	/* last pushed		*/
+	struct ngc_cmd *tail;			/* next to pop		*/
+	struct ngc_cmd stub;
+};
+
+struct ngc_queue *ngc_queue_alloc (void)
+{
+	struct ngc_queue *o;
+
+	if ((o = calloc (1, sizeof (*o))) == NULL)
+		return NULL;
+
+	atomic_init (&o->stub.next, NULL);
+	atomic_init (&o->head, &o->stub);
+	o->tail = &o->stub;
+	return o;
+}
+
+void ngc_queue_free (struct ngc_queue *o)
+{
+	struct ngc_cmd *c;
+
+	if (o == NULL)
+		return;
+
+	while ((c = ngc_queue_pop (o)) != NULL)
+		free (c);
+
+	free (o);
+}
+
+static void ngc_queue_push (struct ngc_queue *o, struct ngc_cmd *c)
+{
+	struct ngc_cmd *prev;
+
+	atomic_store_explicit (&c->next, NULL, memory_order_relaxed);
+	prev = atomic_exchange_explicit (&o->head, c, memory_order_acq_rel);
+	atomic_store_explicit (&prev->next, c, memory_order_release);
+}
+
+int ngc_queue_block (struct ngc_queue *o, const char *line)
+{
+	size_t len = strlen (line);
+	struct ngc_cmd *c;
+
+	if ((c = malloc (sizeof (*c) + len + 1)) == NULL)
+		return 0;
+
+	c->type = NGC_CMD_BLOCK;
+	memcpy (c->line, line, len + 1);
+
+	ngc_queue_push (o, c);
+	return 1;
+}
+
+int ngc_queue_opt (struct ngc_queue *o, int mask, int on)
+{
+	struct ngc_cmd *c;
+
+	if ((c = malloc (sizeof (*c) + 1)) == NULL)
+		return 0;
+
+	c->type = NGC_CMD_OPT;
+	c->mask = mask;
+	c->on   = on;
+	c->line[0] = '\0';
+
+	ngc_queue_push (o, c);
+	return 1;
+}
+
+static struct ngc_cmd *ngc_queue_next (struct ngc_cmd *c)
+{
+	return atomic_load_explicit (&c->next, memory_order_acquire);
+}
+
+struct ngc_cmd *ngc_queue_pop (struct ngc_queue *o)
+{
+	struct ngc_cmd *tail = o->tail, *next = ngc_queue_next (tail);
+
+	if (tail == &o->stub) {
+		if (next == NULL)
+			return NULL;
+
+		o->tail = tail = next;
+		next = ngc_queue_next (next);
+	}
+
+	if (next != NULL) {
+		o->tail = next;
+		return tail;
+	}
+
+	if (tail != atomic_load_explicit (&o->head, memory_order_acquire))
+		return NULL;  /* push in progress */
+
+	ngc_queue_push (o, &o->stub);
+
+	if ((next = ngc_queue_next (tail)) == NULL)
+		return NULL;
+
+	o->tail = next;
+	return tail;
+}
@@ -0,0 +1,46 @@
+/*
+ * NIST RS274/NGC Command Queue
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_QUEUE_H
+#define NGC_QUEUE_H  1
+
+#include <stdatomic.h>
+
+/*
+ * Commands injected into running program: blocks (MDI) and device option
+ * changes (overrides). Injected blocks are executed between program
+ * blocks as if they were in program text.
+ */
+enum ngc_cmd_type {
+	NGC_CMD_BLOCK,
+	NGC_CMD_OPT,
+};
+
+struct ngc_cmd {
+	_Atomic (struct ngc_cmd *) next;
+	int type;
+	int mask, on;			/* option change		*/
+	char line[];			/* block text			*/
+};
+
+/*
+ * Multi-producer single-consumer queue: any thread pushes commands
+ * without locks, the interpreter thread pops them at block boundaries.
+ * Pop returns NULL if the queue is empty (or a push is in progress),
+ * popped command must be freed by the consumer.
+ */
+struct ngc_queue *ngc_queue_alloc (void);
+void ngc_queue_free (struct ngc_queue *o);
+
+int ngc_queue_block (struct ngc_queue *o, const char *line);
+int ngc_queue_opt   (struct ngc_queue *o, int mask, int on);
+
+struct ngc_cmd *ngc_queue_pop (struct ngc_queue *o);
+
+#endif  /* NGC_QUEUE_H */
@@ -0,0 +1,569 @@
+/*
+ * NIST RS274/NGC Recording Device
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ngc-driver.h"
+#include "ngc-record.h"
+
+enum ngc_record_op {
+	NGC_REC_RESET = 1,
+	NGC_REC_BLOCK,
+	NGC_REC_MODE,
+	NGC_REC_CONF,
+	NGC_REC_OFFSET,
+	NGC_REC_HOME,
+	NGC_REC_MOVE,
+	NGC_REC_LINE,
+	NGC_REC_CARC,
+	NGC_REC_RARC,
+	NGC_REC_DWELL,
+	NGC_REC_PROBE,
+	NGC_REC_STOP,
+	NGC_REC_SPINDLE,
+	NGC_REC_TOOL,
+	NGC_REC_CUTTER,
+	NGC_REC_COMMENT,
+	NGC_REC_MESSAGE,
+	NGC_REC_OPT,
+	NGC_REC_COOLANT,
+	NGC_REC_PALLET,
+};
+
+/*
+ * Vector delta state, same on both recording and replaying sides
+ */
+struct ngc_record_ctx {
+	long line;			/* last block line number	*/
+	double end[NGC_AXES];		/* last end point		*/
+	double offset[NGC_AXES];	/* last origin			*/
+};
+
+struct ngc_record {
+	struct ngc_device device;
+	FILE *out;
+	struct ngc_record_ctx ctx;
+};
+
+static struct ngc_record *ngc_record (struct ngc_device *o)
+{
+	return (struct ngc_record *) o;
+}
+
+/*
+ * Trace writer
+ */
+static void ngc_put_uint (FILE *to, uint64_t x)
+{
+	for (; x >= 0x80; x >>= 7)
+		putc ((x & 0x7f) | 0x80, to);
+
+	putc (x, to);
+}
+
+static void ngc_put_int (FILE *to, int64_t x)
+{
+	ngc_put_uint (to, ((uint64_t) x << 1) ^ (uint64_t) (x >> 63));
+}
+
+static void ngc_put_double (FILE *to, double x)
+{
+	fwrite (&x, sizeof (x), 1, to);
+}
+
+static void ngc_put_vec (FILE *to, double *last, const double *v, int count)
+{
+	unsigned mask = 0;
+	int i;
+
+	for (i = 0; i < count; ++i)
+		if (memcmp (last + i, v + i, sizeof (v[i])) != 0)
+			mask |= 1u << i;
+
+	ngc_put_uint (to, mask);
+
+	for (i = 0; i < count; ++i)
+		if ((mask >> i) & 1)
+			ngc_put_double (to, last[i] = v[i]);
+}
+
+static int ngc_put_op (struct ngc_device *dev, int op, int64_t a, int64_t b)
+{
+	FILE *to = ngc_record (dev)->out;
+
+	putc (op, to);
+	ngc_put_int (to, a);
+	ngc_put_int (to, b);
+	return !ferror (to);
+}
+
+static int ngc_put_str (struct ngc_device *dev, int op, const char *s)
+{
+	FILE *to = ngc_record (dev)->out;
+	size_t len = strlen (s) + 1;
+
+	putc (op, to);
+	ngc_put_uint (to, len);
+	fwrite (s, len, 1, to);
+	return !ferror (to);
+}
+
+static struct ngc_device *ngc_record_alloc (const char *path)
+{
+	struct ngc_record *o;
+
+	if (path == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if ((o = calloc (1, sizeof (*o))) == NULL)
+		return NULL;
+
+	o->device.driver = &ngc_record_driver;
+
+	if ((o->out = fopen (path, "wb")) == NULL)
+		goto no_file;
+
+	setvbuf (o->out, NULL, _IOFBF, 1 << 16);
+	fputs (NGC_RECORD_MAGIC, o->out);
+	return &o->device;
+no_file:
+	free (o);
+	return NULL;
+}
+
+/*
+ * The trace is written with a large buffer, push it out at program
+ * stop and end points so that a failed write fails the device call
+ * instead of being lost in free
+ */
+static int ngc_record_sync (struct ngc_device *dev)
+{
+	FILE *to = ngc_record (dev)->out;
+
+	return fflush (to) == 0 && !ferror (to);
+}
+
+static void ngc_record_free (struct ngc_device *dev)
+{
+	struct ngc_record *o = ngc_record (dev);
+
+	fclose (o->out);
+	free (o);
+}
+
+static int ngc_record_reset (struct ngc_device *o)
+{
+	return ngc_put_op (o, NGC_REC_RESET, 0, 0) && ngc_record_sync (o);
+}
+
+static int ngc_record_block (struct ngc_device *dev, long line)
+{
+	struct ngc_record *o = ngc_record (dev);
+	long delta = line - o->ctx.line;
+
+	o->ctx.line = line;
+	putc (NGC_REC_BLOCK, o->out);
+	ngc_put_int (o->out, delta);
+	return !ferror (o->out);
+}
+
+static int ngc_record_mode (struct ngc_device *o, int opt, int value)
+{
+	return ngc_put_op (o, NGC_REC_MODE, opt, value);
+}
+
+static int ngc_record_conf (struct ngc_device *o, int opt, double value)
+{
+	FILE *to = ngc_record (o)->out;
+
+	putc (NGC_REC_CONF, to);
+	ngc_put_int (to, opt);
+	ngc_put_double (to, value);
+	return !ferror (to);
+}
+
+static int ngc_record_offset (struct ngc_device *dev, double *vec)
+{
+	struct ngc_record *o = ngc_record (dev);
+
+	putc (NGC_REC_OFFSET, o->out);
+	ngc_put_vec (o->out, o->ctx.offset, vec, NGC_AXES);
+	return !ferror (o->out);
+}
+
+static int ngc_record_home (struct ngc_device *o, int index)
+{
+	return ngc_put_op (o, NGC_REC_HOME, index, 0);
+}
+
+static int
+ngc_record_motion (struct ngc_device *dev, int op, int flag, double *end)
+{
+	struct ngc_record *o = ngc_record (dev);
+
+	putc (op, o->out);
+	ngc_put_int (o->out, flag);
+	ngc_put_vec (o->out, o->ctx.end, end, NGC_AXES);
+	return !ferror (o->out);
+}
+
+static int ngc_record_move (struct ngc_device *o, int abs, double *end)
+{
+	return ngc_record_motion (o, NGC_REC_MOVE, abs, end);
+}
+
+static int ngc_record_line (struct ngc_device *o, int abs, double *end)
+{
+	return ngc_record_motion (o, NGC_REC_LINE, abs, end);
+}
+
+static int
+ngc_record_carc (struct ngc_device *o, double *end, double *c, int cw)
+{
+	double last[3] = {};  /* center offsets are mostly zero */
+
+	ngc_record_motion (o, NGC_REC_CARC, cw, end);
+	ngc_put_vec (ngc_record (o)->out, last, c, 3);
+	return !ferror (ngc_record (o)->out);
+}
+
+static int
+ngc_record_rarc (struct ngc_device *o, double *end, double r, int cw)
+{
+	ngc_record_motion (o, NGC_REC_RARC, cw, end);
+	ngc_put_double (ngc_record (o)->out, r);
+	return !ferror (ngc_record (o)->out);
+}
+
+static int ngc_record_dwell (struct ngc_device *o, double delay)
+{
+	FILE *to = ngc_record (o)->out;
+
+	putc (NGC_REC_DWELL, to);
+	ngc_put_double (to, delay);
+	return !ferror (to);
+}
+
+static int ngc_record_probe (struct ngc_device *o, double *end)
+{
+	return ngc_record_motion (o, NGC_REC_PROBE, 0, end);
+}
+
+static int ngc_record_stop (struct ngc_device *o, int opt)
+{
+	return ngc_put_op (o, NGC_REC_STOP, opt, 0) && ngc_record_sync (o);
+}
+
+static int ngc_record_spindle (struct ngc_device *o, int op, double arg)
+{
+	FILE *to = ngc_record (o)->out;
+
+	putc (NGC_REC_SPINDLE, to);
+	ngc_put_int (to, op);
+	ngc_put_double (to, arg);
+	return !ferror (to);
+}
+
+static int ngc_record_tool (struct ngc_device *o, int op, int slot)
+{
+	return ngc_put_op (o, NGC_REC_TOOL, op, slot);
+}
+
+static int ngc_record_cutter (struct ngc_device *o, int op, int slot)
+{
+	return ngc_put_op (o, NGC_REC_CUTTER, op, slot);
+}
+
+static int ngc_record_comment (struct ngc_device *o, const char *s)
+{
+	return ngc_put_str (o, NGC_REC_COMMENT, s);
+}
+
+static int ngc_record_message (struct ngc_device *o, const char *s)
+{
+	return ngc_put_str (o, NGC_REC_MESSAGE, s);
+}
+
+static int ngc_record_opt (struct ngc_device *o, int mask, int on)
+{
+	return ngc_put_op (o, NGC_REC_OPT, mask, on);
+}
+
+static int ngc_record_coolant (struct ngc_device *o, int mask, int on)
+{
+	return ngc_put_op (o, NGC_REC_COOLANT, mask, on);
+}
+
+static int ngc_record_pallet_shuttle (struct ngc_device *o)
+{
+	return ngc_put_op (o, NGC_REC_PALLET, 0, 0);
+}
+
+const struct ngc_driver ngc_record_driver = {
+	.name		= "record",
+	.alloc		= ngc_record_alloc,
+	.free		= ngc_record_free,
+	.reset		= ngc_record_reset,
+	.block		= ngc_record_block,
+	.mode		= ngc_record_mode,
+	.conf		= ngc_record_conf,
+	.offset		= ngc_record_offset,
+	.home		= ngc_record_home,
+	.move		= ngc_record_move,
+	.line		= ngc_record_line,
+	.carc		= ngc_record_carc,
+	.rarc		= ngc_record_rarc,
+	.dwell		= ngc_record_dwell,
+	.probe		= ngc_record_probe,
+	.stop		= ngc_record_stop,
+	.spindle	= ngc_record_spindle,
+	.tool		= ngc_record_tool,
+	.cutter		= ngc_record_cutter,
+	.comment	= ngc_record_comment,
+	.message	= ngc_record_message,
+	.opt		= ngc_record_opt,
+	.coolant	= ngc_record_coolant,
+	.pallet_shuttle	= ngc_record_pallet_shuttle,
+};
+
+/*
+ * Trace reader
+ */
+struct ngc_reader {
+	const unsigned char *p, *end;
+	int ok;
+	struct ngc_record_ctx ctx;
+};
+
+static uint64_t ngc_get_uint (struct ngc_reader *o)
+{
+	uint64_t x = 0;
+	int shift;
+
+	for (shift = 0; o->p < o->end && shift < 64; shift += 7) {
+		x |= (uint64_t) (*o->p & 0x7f) << shift;
+
+		if ((*o->p++ & 0x80) == 0)
+			return x;
+	}
+
+	o->ok = 0;
+	return 0;
+}
+
+static int64_t ngc_get_int (struct ngc_reader *o)
+{
+	uint64_t x = ngc_get_uint (o);
+
+	return (int64_t) (x >> 1) ^ -(int64_t) (x & 1);
+}
+
+static double ngc_get_double (struct ngc_reader *o)
+{
+	double x;
+
+	if (o->end - o->p < (long) sizeof (x)) {
+		o->ok = 0;
+		return 0;
+	}
+
+	memcpy (&x, o->p, sizeof (x));
+	o->p += sizeof (x);
+	return x;
+}
+
+static double *ngc_get_vec (struct ngc_reader *o, double *last, int count)
+{
+	uint64_t mask = ngc_get_uint (o);
+	int i;
+
+	if ((mask >> count) != 0)
+		o->ok = 0;
+
+	for (i = 0; o->ok && i < count; ++i)
+		if ((mask >> i) & 1)
+			last[i] = ngc_get_double (o);
+
+	return last;
+}
+
+static const char *ngc_get_str (struct ngc_reader *o)
+{
+	uint64_t len = ngc_get_uint (o);
+	const char *s = (const char *) o->p;
+
+	if (!o->ok || len == 0 || len > (uint64_t) (o->end - o->p) ||
+	    o->p[len - 1] != '\0') {
+		o->ok = 0;
+		return "";
+	}
+
+	o->p += len;
+	return s;
+}
+
+/*
+ * Replay one record, the device is not called if the record is broken
+ */
+static int ngc_record_step (struct ngc_reader *o, struct ngc_device *dev)
+{
+	double c[3] = {}, *end, x;
+	const char *s;
+	int64_t a, b;
+
+	switch (*o->p++) {
+	case NGC_REC_RESET:
+		a = ngc_get_int (o), b = ngc_get_int (o);
+		return !o->ok || ngc_device_reset (dev);
+
+	case NGC_REC_BLOCK:
+		o->ctx.line += ngc_get_int (o);
+		return !o->ok || ngc_device_block (dev, o->ctx.line);
+
+	case NGC_REC_MODE:
+		a = ngc_get_int (o), b = ngc_get_int (o);
+		return !o->ok || ngc_device_mode (dev, a, b);
+
+	case NGC_REC_CONF:
+		a = ngc_get_int (o), x = ngc_get_double (o);
+		return !o->ok || ngc_device_conf (dev, a, x);
+
+	case NGC_REC_OFFSET:
+		end = ngc_get_vec (o, o->ctx.offset, NGC_AXES);
+		return !o->ok || ngc_device_offset (dev, end);
+
+	case NGC_REC_HOME:
+		a = ngc_get_int (o), b = ngc_get_int (o);
+		return !o->ok || ngc_device_home (dev, a);
+
+	case NGC_REC_MOVE:
+		a   = ngc_get_int (o);
+		end = ngc_get_vec (o, o->ctx.end, NGC_AXES);
+		return !o->ok || ngc_device_move (dev, a, end);
+
+	case NGC_REC_LINE:
+		a   = ngc_get_int (o);
+		end = ngc_get_vec (o, o->ctx.end, NGC_AXES);
+		return !o->ok || ngc_device_line (dev, a, end);
+
+	case NGC_REC_CARC:
+		a   = ngc_get_int (o);
+		end = ngc_get_vec (o, o->ctx.end, NGC_AXES);
+		ngc_get_vec (o, c, 3);
+		return !o->ok || ngc_device_carc (dev, end, c, a);
+
+	case NGC_REC_RARC:
+		a   = ngc_get_int (o);
+		end = ngc_get_vec (o, o->ctx.end, NGC_AXES);
+		x = ngc_get_double (o);
+		return !o->ok || ngc_device_rarc (dev, end, x, a);
+
+	case NGC_REC_DWELL:
+		x = ngc_get_double (o);
+		return !o->ok || ngc_device_dwell (dev, x);
+
+	case NGC_REC_PROBE:
+		a   = ngc_get_int (o);
+		end = ngc_get_vec (o, o->ctx.end, NGC_AXES);
+		return !o->ok || ngc_device_probe (dev, end);
+
+	case NGC_REC_STOP:
+		a = ngc_get_int (o), b = ngc_get_int (o);
+		return !o->ok || ngc_device_stop (dev, a);
+
+	case NGC_REC_SPINDLE:
+		a = ngc_get_int (o), x = ngc_get_double (o);
+		return !o->ok || ngc_device_spindle (dev, a, x);
+
+	case NGC_REC_TOOL:
+		a = ngc_get_int (o), b = ngc_get_int (o);
+		return !o->ok || ngc_device_tool (dev, a, b);
+
+	case NGC_REC_CUTTER:
+		a = ngc_get_int (o), b = ngc_get_int (o);
+		return !o->ok || ngc_device_cutter (dev, a, b);
+
+	case NGC_REC_COMMENT:
+		s = ngc_get_str (o);
+		return !o->ok || ngc_device_comment (dev, s);
+
+	case NGC_REC_MESSAGE:
+		s = ngc_get_str (o);
+		return !o->ok || ngc_device_message (dev, s);
+
+	case NGC_REC_OPT:
+		a = ngc_get_int (o), b = ngc_get_int (o);
+		return !o->ok || ngc_device_opt (dev, a, b);
+
+	case NGC_REC_COOLANT:
+		a = ngc_get_int (o), b = ngc_get_int (o);
+		return !o->ok || ngc_device_coolant (dev, a, b);
+
+	case NGC_REC_PALLET:
+		a = ngc_get_int (o), b = ngc_get_int (o);
+		return !o->ok || ngc_device_pallet_shuttle (dev);
+	}
+
+	o->ok = 0;
+	return 1;
+}
+
+int ngc_record_play (const void *trace, size_t size, struct ngc_device *dev)
+{
+	const size_t len = sizeof (NGC_RECORD_MAGIC) - 1;
+	struct ngc_reader o = { .p = trace, .end = o.p + size, .ok = 1 };
+
+	if (size < len || memcmp (trace, NGC_RECORD_MAGIC, len) != 0)
+		goto broken;
+
+	for (o.p += len; o.ok && o.p < o.end;)
+		if (!ngc_record_step (&o, dev))
+			return 0;
+
+	if (o.ok)
+		return 1;
+broken:
+	errno = EINVAL;
+	return 0;
+}
+
+int ngc_record_replay (const char *path, struct ngc_device *dev)
+{
+	struct stat st;
+	void *p;
+	int fd, ok;
+
+	if ((fd = open (path, O_RDONLY)) == -1)
+		return 0;
+
+	if (fstat (fd, &st) != 0 ||
+	    (p = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0))
+	    == MAP_FAILED) {
+		close (fd);
+		return 0;
+	}
+
+	madvise (p, st.st_size, MADV_SEQUENTIAL);
+	ok = ngc_record_play (p, st.st_size, dev);
+
+	munmap (p, st.st_size);
+	close (fd);
+	return ok;
+}
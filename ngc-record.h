@@ -0,0 +1,36 @@
+/*
+ * NIST RS274/NGC Recording Device
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_RECORD_H
+#define NGC_RECORD_H  1
+
+#include <stddef.h>
+
+#include "ngc-device.h"
+
+/*
+ * The "record:path" device writes every device call into the binary
+ * trace file. The trace is a header followed by records: an operation
+ * code and its arguments, integers are zigzag varints, vectors are
+ * stored as a mask of components changed since the previous vector of
+ * the same kind followed by the changed components. Floating point
+ * values are stored in host byte order. The trace is flushed at program
+ * stop and end points, write errors fail the device call there.
+ */
+#define NGC_RECORD_MAGIC	"NGCT\1"
+
+/*
+ * Replay the trace (mapped or loaded in memory, or from the file) into
+ * the device. Returns zero on the first failed device call or on broken
+ * trace (errno is set to EINVAL then).
+ */
+int ngc_record_play   (const void *trace, size_t size, struct ngc_device *dev);
+int ngc_record_replay (const char *path, struct ngc_device *dev);
+
+#endif  /* NGC_RECORD_H */
@@ -0,0 +1,62 @@
+/*
+ * NIST RS274/NGC Block Ring
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+
+#include "ngc-state.h"
+
+int ngc_ring_init (struct ngc_ring *o, size_t depth,
+		   const struct ngc_state *init)
+{
+	if (depth < 2)
+		depth = 2;
+
+	if ((o->slot = malloc (depth * sizeof (o->slot[0]))) == NULL)
+		return 0;
+
+	o->depth = depth;
+	ngc_ring_reset (o, init);
+	return 1;
+}
+
+void ngc_ring_fini (struct ngc_ring *o)
+{
+	free (o->slot);
+	o->slot = NULL;
+}
+
+/*
+ * Bulk reset: all slots get the initial state, the head slot is the
+ * previous block for the first one to come.
+ */
+void ngc_ring_reset (struct ngc_ring *o, const struct ngc_state *init)
+{
+	size_t i;
+
+	for (i = 0; i < o->depth; ++i) {
+		o->slot[i] = *init;
+		o->slot[i].prev = NULL;
+	}
+
+	o->head = 0;
+}
+
+struct ngc_state *ngc_ring_next (struct ngc_ring *o)
+{
+	struct ngc_state *prev = o->slot + o->head, *cur;
+
+	o->head = (o->head + 1) % o->depth;
+	cur = o->slot + o->head;
+
+	cur->prev = prev;
+	cur->var  = prev->var;
+	cur->ctx  = prev->ctx;
+	cur->line = prev->line + 1;
+	return cur;
+}
@@ -0,0 +1,98 @@
+/*
+ * NIST RS274/NGC Program Runner
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ngc-state.h"
+
+static int ngc_run_block (struct ngc_state *o, char *line,
+			  struct ngc_device *dev)
+{
+	/* parameters could be results of pending operations */
+	return	ngc_scan  (o, line) && ngc_sync (o, dev, 0) &&
+		ngc_parse (o, line) && ngc_check (o) &&
+		ngc_deps  (o) && ngc_sync (o, dev, 0) &&
+		ngc_exec  (o, dev);
+}
+
+/*
+ * Execute injected commands queued so far. Injected blocks have no
+ * source line number.
+ */
+static int ngc_run_queue (struct ngc_ring *r, struct ngc_device *dev)
+{
+	struct ngc_state *cur = ngc_ring_get (r, 0);
+	struct ngc_cmd *c;
+	int ok = 1;
+
+	while (ok && cur->prev != NULL && (c = ngc_queue_pop (cur->ctx.queue))) {
+		if (c->type == NGC_CMD_OPT)
+			ok = ngc_device_opt (dev, c->mask, c->on);
+		else {
+			cur = ngc_ring_next (r);
+			cur->line = 0;
+			ok = ngc_run_block (cur, c->line, dev);
+		}
+
+		free (c);
+	}
+
+	return ok;
+}
+
+/*
+ * Run program from the stream till the end of file or program end (M2).
+ * On entry the state holds the initial (previous) block, on exit it
+ * holds the last executed block. Commands injected into the queue of
+ * the state are executed between program blocks, comments posted into
+ * the comment channel are delivered on exit.
+ */
+int ngc_run (struct ngc_state *o, FILE *in, struct ngc_device *dev)
+{
+	struct ngc_ring r;
+	struct ngc_state *cur;
+	char *line = NULL;
+	size_t size = 0;
+	long n = o->line;
+	int ok = 1;
+
+	if (!ngc_ring_init (&r, 2, o))
+		return ngc_error (o, "%s", strerror (errno));
+
+	for (cur = r.slot; ok && getline (&line, &size, in) > 0;) {
+		cur = ngc_ring_next (&r);
+		cur->line = ++n;
+
+		ok = ngc_run_block (cur, line, dev);
+
+		if (ok && cur->ctx.queue != NULL) {
+			ok  = ngc_run_queue (&r, dev);
+			cur = ngc_ring_get (&r, 0);
+		}
+
+		if (cur->prev == NULL)  /* program end */
+			break;
+	}
+
+	if (ok)
+		ok = ngc_sync (cur, dev, 1);
+
+	if (cur->ctx.notes != NULL && !ngc_notes_flush (cur->ctx.notes, dev))
+		ok = 0;
+
+	free (line);
+	*o = *cur;
+	o->line = n;
+	o->prev = NULL;
+	o->comment = NULL;
+	ngc_ring_fini (&r);
+	return ok;
+}
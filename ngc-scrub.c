@@ -0,0 +1,385 @@
+/*
+ * NIST RS274/NGC Reversible Execution
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ngc-scrub.h"
+
+/*
+ * Internal state entries: modal state, current point, program origin
+ * and the like. Blocks without parameter settings, coordinate system
+ * changes and probing change these entries only.
+ */
+#define NGC_ILEN  (NGC_VSIZE - NGC_REL)
+
+struct ngc_delta {
+	size_t index;
+	double value;
+};
+
+struct ngc_key {
+	long pos;
+	size_t off;
+	int end;
+	struct ngc_state last;
+	size_t delta;			/* end of parameter deltas	*/
+};
+
+struct ngc_undo {
+	size_t off;
+	int end, local;
+	struct ngc_state last;
+};
+
+struct ngc_scrub {
+	struct ngc_device *dev;
+	const char *text;
+	size_t len, period;
+
+	struct ngc_ring ring;
+	double *var, *var0, *shadow;	/* live, initial, last keyframe	*/
+	double *save;			/* parameters before the block	*/
+	size_t dlen;			/* device state size		*/
+
+	long pos;			/* executed blocks		*/
+	size_t off;			/* next block offset		*/
+	int end;
+
+	char *line;
+	size_t size;
+
+	struct ngc_key *key;
+	double *key_var;		/* internal state of keyframes	*/
+	char *key_dev;
+	size_t keys;
+
+	struct ngc_delta *delta;
+	size_t deltas, avail;
+
+	struct ngc_undo *undo;		/* ring of period records	*/
+	double *undo_var;
+	char *undo_dev;
+	size_t undos;			/* valid records		*/
+};
+
+/*
+ * Keyframe keeps the internal state as a whole and the parameters
+ * changed since the previous keyframe as deltas: parameters change
+ * rarely, the internal state changes every block.
+ */
+static int ngc_scrub_key (struct ngc_scrub *o)
+{
+	struct ngc_key *key;
+	struct ngc_delta *d;
+	double *var;
+	char *dev;
+	size_t i;
+
+	if ((key = realloc (o->key, (o->keys + 1) * sizeof (*key))) == NULL)
+		return 0;
+
+	o->key = key;
+
+	if ((dev = realloc (o->key_dev, (o->keys + 1) * o->dlen + 1)) == NULL)
+		return 0;
+
+	o->key_dev = dev;
+
+	var = realloc (o->key_var, (o->keys + 1) * NGC_ILEN * sizeof (*var));
+
+	if (var == NULL)
+		return 0;
+
+	o->key_var = var;
+
+	for (i = 0; i < NGC_REL; ++i) {
+		if (o->var[i] == o->shadow[i])
+			continue;
+
+		if (o->deltas == o->avail) {
+			o->avail = o->avail == 0 ? 256 : o->avail * 2;
+			d = realloc (o->delta, o->avail * sizeof (*d));
+
+			if (d == NULL)
+				return 0;
+
+			o->delta = d;
+		}
+
+		o->delta[o->deltas].index = i;
+		o->delta[o->deltas].value = o->var[i];
+		++o->deltas;
+
+		o->shadow[i] = o->var[i];
+	}
+
+	key += o->keys;
+	key->pos   = o->pos;
+	key->off   = o->off;
+	key->end   = o->end;
+	key->last  = *ngc_ring_get (&o->ring, 0);
+	key->delta = o->deltas;
+
+	memcpy (var + o->keys * NGC_ILEN, o->var + NGC_REL,
+		NGC_ILEN * sizeof (o->var[0]));
+	ngc_device_save (o->dev, dev + o->keys * o->dlen, o->dlen);
+	++o->keys;
+	return 1;
+}
+
+static int ngc_scrub_restore (struct ngc_scrub *o, size_t k)
+{
+	const struct ngc_key *key = o->key + k;
+	size_t i;
+
+	memcpy (o->var, o->var0, NGC_REL * sizeof (o->var[0]));
+
+	for (i = 0; i < key->delta; ++i)
+		o->var[o->delta[i].index] = o->delta[i].value;
+
+	memcpy (o->var + NGC_REL, o->key_var + k * NGC_ILEN,
+		NGC_ILEN * sizeof (o->var[0]));
+	memcpy (o->save, o->var, NGC_REL * sizeof (o->var[0]));
+
+	*ngc_ring_get (&o->ring, 0) = key->last;
+
+	o->pos   = key->pos;
+	o->off   = key->off;
+	o->end   = key->end;
+	o->undos = 0;
+
+	return ngc_device_load (o->dev, o->key_dev + k * o->dlen, o->dlen);
+}
+
+struct ngc_scrub *ngc_scrub_alloc (struct ngc_state *init,
+				   struct ngc_device *dev,
+				   const char *text, size_t len, size_t period)
+{
+	const size_t vlen = NGC_VSIZE * sizeof (init->var[0]);
+	struct ngc_scrub *o;
+
+	if ((o = calloc (1, sizeof (*o))) == NULL)
+		return NULL;
+
+	o->dev    = dev;
+	o->text   = text;
+	o->len    = len;
+	o->period = period > 0 ? period : 1;
+	o->var    = init->var;
+	o->dlen   = ngc_device_save (dev, NULL, 0);
+
+	if (!ngc_ring_init (&o->ring, 2, init) ||
+	    (o->var0 = malloc (vlen)) == NULL ||
+	    (o->shadow = malloc (vlen)) == NULL ||
+	    (o->save = malloc (vlen)) == NULL ||
+	    (o->undo = malloc (o->period * sizeof (o->undo[0]))) == NULL ||
+	    (o->undo_var = malloc (o->period * NGC_ILEN * sizeof (double)))
+	    == NULL ||
+	    (o->undo_dev = malloc (o->period * o->dlen + 1)) == NULL)
+		goto no_mem;
+
+	memcpy (o->var0,   o->var, vlen);
+	memcpy (o->shadow, o->var, vlen);
+	memcpy (o->save,   o->var, vlen);
+
+	if (ngc_scrub_key (o))
+		return o;
+no_mem:
+	ngc_scrub_free (o);
+	return NULL;
+}
+
+void ngc_scrub_free (struct ngc_scrub *o)
+{
+	if (o == NULL)
+		return;
+
+	free (o->undo_dev);
+	free (o->undo_var);
+	free (o->undo);
+	free (o->delta);
+	free (o->key_dev);
+	free (o->key_var);
+	free (o->key);
+	free (o->line);
+	free (o->save);
+	free (o->shadow);
+	free (o->var0);
+	ngc_ring_fini (&o->ring);
+	free (o);
+}
+
+/*
+ * Tool change, length offset and cutter compensation blocks load tool
+ * parameters from the tool table, if any.
+ */
+static int ngc_scrub_tool (struct ngc_state *b)
+{
+	return	b->ctx.tools != NULL &&
+		(b->g[NGC_M6] != 0 || b->g[NGC_G8] == NGC_G0430 ||
+		 b->g[NGC_G7] == NGC_G0410 || b->g[NGC_G7] == NGC_G0420);
+}
+
+/*
+ * A block changes internal state only if it has no parameter settings,
+ * does not change coordinate system data or offsets, does not load tool
+ * data, does not probe and does not end the program (reset changes
+ * offsets).
+ */
+static int ngc_scrub_local (struct ngc_state *b, const char *line, size_t len)
+{
+	return	memchr (line, '=', len) == NULL && !ngc_scrub_tool (b) &&
+		b->g[NGC_G0] != NGC_G0100 && b->g[NGC_G0] != NGC_G0920 &&
+		b->g[NGC_G0] != NGC_G0921 && b->g[NGC_G0] != NGC_G0922 &&
+		b->g[NGC_G0] != NGC_G0923 && b->g[NGC_G12] == 0 &&
+		b->g[NGC_G1] != NGC_G0382 && b->g[NGC_M4] == 0;
+}
+
+static void ngc_scrub_undo (struct ngc_scrub *o)
+{
+	size_t i = (o->pos - 1) % o->period;
+	const struct ngc_undo *u = o->undo + i;
+
+	memcpy (o->var + NGC_REL, o->undo_var + i * NGC_ILEN,
+		NGC_ILEN * sizeof (o->var[0]));
+	ngc_device_load (o->dev, o->undo_dev + i * o->dlen, o->dlen);
+
+	*ngc_ring_get (&o->ring, 0) = u->last;
+
+	--o->pos;
+	--o->undos;
+	o->off = u->off;
+	o->end = u->end;
+}
+
+int ngc_scrub_step (struct ngc_scrub *o)
+{
+	size_t i = o->pos % o->period, len;
+	const char *line = o->text + o->off, *p;
+	struct ngc_undo *u = o->undo + i;
+	struct ngc_state *b;
+	char *q;
+
+	if (o->end || o->off >= o->len)
+		return 0;
+
+	p = memchr (line, '\n', o->len - o->off);
+	len = p != NULL ? p - line + 1 : o->len - o->off;
+
+	if (len >= o->size) {
+		if ((q = realloc (o->line, len + 1)) == NULL)
+			return 0;
+
+		o->line = q;
+		o->size = len + 1;
+	}
+
+	memcpy (o->line, line, len);
+	o->line[len] = '\0';
+
+	u->off  = o->off;
+	u->end  = o->end;
+	u->last = *ngc_ring_get (&o->ring, 0);
+
+	memcpy (o->undo_var + i * NGC_ILEN, o->var + NGC_REL,
+		NGC_ILEN * sizeof (o->var[0]));
+	ngc_device_save (o->dev, o->undo_dev + i * o->dlen, o->dlen);
+
+	++o->pos;
+	++o->undos;
+	o->off += len;
+
+	b = ngc_ring_next (&o->ring);
+
+	/*
+	 * Pending operations are completed to keep snapshots exact. The
+	 * failed block could set parameters before the failure, thus they
+	 * are restored as well.
+	 */
+	if (!ngc_parse (b, o->line) || !ngc_check (b) ||
+	    !ngc_exec (b, o->dev) || !ngc_sync (b, o->dev, 1)) {
+		memcpy (o->var, o->save, NGC_REL * sizeof (o->var[0]));
+		ngc_scrub_undo (o);
+		return 0;
+	}
+
+	u->local = ngc_scrub_local (b, line, len);
+	o->end   = b->prev == NULL;
+
+	if (!u->local)
+		memcpy (o->save, o->var, NGC_REL * sizeof (o->var[0]));
+
+	if (o->undos > o->period)
+		o->undos = o->period;
+
+	if (o->pos == (long) (o->keys * o->period))
+		return ngc_scrub_key (o);
+
+	return 1;
+}
+
+int ngc_scrub_back (struct ngc_scrub *o)
+{
+	if (o->pos == 0)
+		return 0;
+
+	if (o->undos > 0 && o->undo[(o->pos - 1) % o->period].local) {
+		ngc_scrub_undo (o);
+		return 1;
+	}
+
+	return ngc_scrub_seek (o, o->pos - 1);
+}
+
+/*
+ * Undo records are used while the blocks are local, then the nearest
+ * keyframe is restored if it is closer than the current block
+ */
+int ngc_scrub_seek (struct ngc_scrub *o, long block)
+{
+	size_t k;
+
+	if (block < 0)
+		return 0;
+
+	while (o->pos > block && o->undos > 0 &&
+	       o->undo[(o->pos - 1) % o->period].local)
+		ngc_scrub_undo (o);
+
+	k = block / o->period;
+
+	if (k >= o->keys)
+		k = o->keys - 1;
+
+	if ((o->pos > block || o->key[k].pos > o->pos) &&
+	    !ngc_scrub_restore (o, k))
+		return 0;
+
+	while (o->pos < block)
+		if (!ngc_scrub_step (o))
+			return 0;
+
+	return 1;
+}
+
+long ngc_scrub_pos (struct ngc_scrub *o)
+{
+	return o->pos;
+}
+
+int ngc_scrub_end (struct ngc_scrub *o)
+{
+	return o->end || o->off >= o->len;
+}
+
+struct ngc_state *ngc_scrub_state (struct ngc_scrub *o)
+{
+	return ngc_ring_get (&o->ring, 0);
+}
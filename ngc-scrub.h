@@ -0,0 +1,47 @@
+/*
+ * NIST RS274/NGC Reversible Execution
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_SCRUB_H
+#define NGC_SCRUB_H  1
+
+#include "ngc-state.h"
+
+/*
+ * Reversible execution for simulation scrubbing. The program text is
+ * executed block by block into the device. Every period blocks a
+ * keyframe is taken: the internal state, parameters changed since the
+ * previous keyframe, the block state and the device state. Undo records
+ * are kept for the last period blocks. Step back restores the undo record
+ * of the last block if the block changed internal state only, seek
+ * restores the nearest keyframe and runs the program forward from it. A
+ * failed step leaves the state as it was before the block.
+ *
+ * The initial state and the device must be reset by the caller, the
+ * parameter store of the initial state is used as is. The program text
+ * must stay valid till the scrubber is freed.
+ */
+struct ngc_scrub *ngc_scrub_alloc (struct ngc_state *init,
+				   struct ngc_device *dev,
+				   const char *text, size_t len, size_t period);
+void ngc_scrub_free (struct ngc_scrub *o);
+
+int ngc_scrub_step (struct ngc_scrub *o);
+int ngc_scrub_back (struct ngc_scrub *o);
+int ngc_scrub_seek (struct ngc_scrub *o, long block);
+
+/*
+ * Number of executed blocks, end of program flag and the last executed
+ * block state
+ */
+long ngc_scrub_pos (struct ngc_scrub *o);
+int  ngc_scrub_end (struct ngc_scrub *o);
+
+struct ngc_state *ngc_scrub_state (struct ngc_scrub *o);
+
+#endif  /* NGC_SCRUB_H */
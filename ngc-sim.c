@@ -0,0 +1,525 @@
+/*
+ * NIST RS274/NGC Simulation Device
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ngc-driver.h"
+#include "ngc-toolpath.h"
+#include "ngc-sim.h"
+
+#define NGC_SIM_MAX_RATE	10000	/* default traverse rate, mm/min */
+
+struct ngc_sim {
+	struct ngc_device device;
+
+	double pos[NGC_AXES];		/* machine position		*/
+	double origin[NGC_AXES];	/* program origin, program units */
+	double scale;			/* program units to millimeters	*/
+	int plane, inverse, relative;
+	double rate, max_rate;
+	double lo[NGC_AXES], hi[NGC_AXES];	/* travel limits	*/
+
+	int async;			/* complete probes on poll	*/
+	int ready;
+	struct ngc_result done;
+
+	struct ngc_sim_stat stat;
+	char error[64];
+
+	int spindle;			/* spindle is running		*/
+	int tool;			/* tool in the spindle		*/
+	int tlo;			/* length offset tool, -1 if off */
+	long line;			/* current block line number	*/
+	struct ngc_toolpath *tp;	/* swept segments or NULL	*/
+};
+
+static struct ngc_sim *ngc_sim (struct ngc_device *o)
+{
+	return (struct ngc_sim *) o;
+}
+
+static int ngc_sim_fail (struct ngc_sim *o, const char *reason)
+{
+	o->stat.error = reason;
+	return 0;
+}
+
+/*
+ * Add swept point to the envelope and check it against travel limits.
+ * Line envelope is spanned by its end points, arc envelope also needs
+ * the quadrant points passed by the arc.
+ */
+static int ngc_sim_box (struct ngc_sim *o, const double *p)
+{
+	static const char name[] = "XYZABCUVW";
+	int i;
+
+	for (i = 0; i < NGC_AXES; ++i) {
+		if (p[i] < o->lo[i] || p[i] > o->hi[i]) {
+			snprintf (o->error, sizeof (o->error),
+				  "Soft limit exceeded on %c axis: %g",
+				  name[i], p[i]);
+			return ngc_sim_fail (o, o->error);
+		}
+
+		if (p[i] < o->stat.min[i])	o->stat.min[i] = p[i];
+		if (p[i] > o->stat.max[i])	o->stat.max[i] = p[i];
+	}
+
+	return 1;
+}
+
+static int ngc_sim_is_rotary (int axis)
+{
+	return axis >= 3 && axis < 6;  /* A, B, C */
+}
+
+/*
+ * Convert end point to machine coordinates
+ */
+static void ngc_sim_target (struct ngc_sim *o, int abs, const double *end,
+			    double *p)
+{
+	int i;
+
+	for (i = 0; i < NGC_AXES; ++i) {
+		double k = ngc_sim_is_rotary (i) ? 1 : o->scale;
+
+		if (o->relative && !abs)
+			p[i] = o->pos[i] + end[i] * k;
+		else
+			p[i] = (abs ? end[i] : end[i] + o->origin[i]) * k;
+	}
+}
+
+/*
+ * Straight path length: linear axes if any of them moves, rotary else
+ */
+static double ngc_sim_length (const double *a, const double *b)
+{
+	double l = 0, r = 0;
+	int i;
+
+	for (i = 0; i < NGC_AXES; ++i)
+		if (ngc_sim_is_rotary (i))
+			r += (b[i] - a[i]) * (b[i] - a[i]);
+		else
+			l += (b[i] - a[i]) * (b[i] - a[i]);
+
+	return sqrt (l > 0 ? l : r);
+}
+
+static int ngc_sim_feed (struct ngc_sim *o, double length)
+{
+	if (o->rate <= 0)
+		return ngc_sim_fail (o, "Zero feed rate");
+
+	o->stat.time += o->inverse ? 1 / o->rate :
+				     length / (o->rate * o->scale);
+	++o->stat.moves;
+	return 1;
+}
+
+/*
+ * Add swept segment from the current position to p to the path, if any
+ */
+static int ngc_sim_seg (struct ngc_sim *o, struct ngc_seg *s, const double *p)
+{
+	if (o->tp == NULL)
+		return 1;
+
+	s->line    = o->line;
+	s->tool    = o->tool;
+	s->tlo     = o->tlo == 0 ? o->tool : o->tlo;
+	s->spindle = o->spindle;
+	memcpy (s->start, o->pos, sizeof (s->start));
+	memcpy (s->end,   p,      sizeof (s->end));
+
+	if (!ngc_toolpath_add (o->tp, s))
+		return ngc_sim_fail (o, "Out of memory for tool path");
+
+	return 1;
+}
+
+static struct ngc_device *ngc_sim_alloc (const char *arg)
+{
+	struct ngc_sim *o;
+	int i;
+
+	if ((o = calloc (1, sizeof (*o))) == NULL)
+		return NULL;
+
+	o->device.driver = &ngc_sim_driver;
+	o->async    = arg != NULL && strcmp (arg, "async") == 0;
+	o->scale    = 1;
+	o->max_rate = NGC_SIM_MAX_RATE;
+	o->tlo      = -1;
+
+	for (i = 0; i < NGC_AXES; ++i) {
+		o->lo[i] = o->stat.max[i] = -INFINITY;
+		o->hi[i] = o->stat.min[i] =  INFINITY;
+	}
+
+	return &o->device;
+}
+
+static void ngc_sim_free (struct ngc_device *o)
+{
+	free (o);
+}
+
+static int ngc_sim_block (struct ngc_device *dev, long line)
+{
+	ngc_sim (dev)->line = line;
+	return 1;
+}
+
+static int ngc_sim_mode (struct ngc_device *dev, int opt, int value)
+{
+	struct ngc_sim *o = ngc_sim (dev);
+
+	switch (opt) {
+	case NGC_MODE_UNITS:
+		o->scale = value == NGC_UNITS_INCHES ? 25.4 : 1;
+		break;
+	case NGC_MODE_PLANE:
+		o->plane = value;
+		break;
+	case NGC_MODE_RATE:
+		o->inverse = value == NGC_RATE_CPM;
+		break;
+	}
+
+	return 1;
+}
+
+static int ngc_sim_conf (struct ngc_device *dev, int opt, double value)
+{
+	struct ngc_sim *o = ngc_sim (dev);
+
+	switch (opt) {
+	case NGC_CONF_RATE:
+		o->rate = value;
+		break;
+	case NGC_CONF_MAX_RATE:
+		o->max_rate = value;
+		break;
+	}
+
+	return 1;
+}
+
+static int ngc_sim_offset (struct ngc_device *dev, double *vec)
+{
+	memcpy (ngc_sim (dev)->origin, vec, sizeof (ngc_sim (dev)->origin));
+	return 1;
+}
+
+static int ngc_sim_move (struct ngc_device *dev, int abs, double *end)
+{
+	struct ngc_sim *o = ngc_sim (dev);
+	struct ngc_seg s = { .type = NGC_SEG_MOVE };
+	double p[NGC_AXES];
+
+	ngc_sim_target (o, abs, end, p);
+
+	if (!ngc_sim_box (o, p) || !ngc_sim_seg (o, &s, p))
+		return 0;
+
+	o->stat.time += ngc_sim_length (o->pos, p) / o->max_rate;
+	++o->stat.moves;
+
+	memcpy (o->pos, p, sizeof (p));
+	return 1;
+}
+
+static int ngc_sim_line (struct ngc_device *dev, int abs, double *end)
+{
+	struct ngc_sim *o = ngc_sim (dev);
+	struct ngc_seg s = { .type = NGC_SEG_LINE };
+	double p[NGC_AXES];
+
+	ngc_sim_target (o, abs, end, p);
+
+	if (!ngc_sim_box (o, p) || !ngc_sim_seg (o, &s, p) ||
+	    !ngc_sim_feed (o, ngc_sim_length (o->pos, p)))
+		return 0;
+
+	memcpy (o->pos, p, sizeof (p));
+	return 1;
+}
+
+/*
+ * Arc in the active plane: a and b are plane axes ordered to keep the
+ * plane normal positive, h is the helix axis.
+ */
+static void ngc_sim_plane (struct ngc_sim *o, int *a, int *b, int *h)
+{
+	switch (o->plane) {
+	case NGC_PLANE_XZ:	*a = 2, *b = 0, *h = 1; break;
+	case NGC_PLANE_YZ:	*a = 1, *b = 2, *h = 0; break;
+	default:		*a = 0, *b = 1, *h = 2; break;
+	}
+}
+
+static int ngc_sim_arc (struct ngc_sim *o, const double *p, double ca,
+			double cb, int cw)
+{
+	struct ngc_seg s;
+	int a, b, h, k;
+	double r, as, ae, sweep, t, q[NGC_AXES];
+
+	ngc_sim_plane (o, &a, &b, &h);
+
+	r  = hypot (o->pos[a] - ca, o->pos[b] - cb);
+	as = atan2 (o->pos[b] - cb, o->pos[a] - ca);
+	ae = atan2 (p[b] - cb, p[a] - ca);
+
+	if (r == 0)
+		return ngc_sim_fail (o, "Zero radius arc");
+
+	sweep = cw ? as - ae : ae - as;
+
+	if (sweep <= 1e-12)
+		sweep += 2 * M_PI;
+
+	if (!ngc_sim_box (o, p))
+		return 0;
+
+	/* add the quadrant points passed by the arc */
+	for (k = 0; k < 4; ++k) {
+		t = (cw ? as - k * M_PI_2 : k * M_PI_2 - as);
+		t = fmod (t + 4 * M_PI, 2 * M_PI);
+
+		if (t >= sweep)
+			continue;
+
+		memcpy (q, p, sizeof (q));
+		q[a] = ca + r * cos (k * M_PI_2);
+		q[b] = cb + r * sin (k * M_PI_2);
+
+		if (!ngc_sim_box (o, q))
+			return 0;
+	}
+
+	s.type   = NGC_SEG_ARC;
+	s.a      = a;
+	s.b      = b;
+	s.center[0] = ca;
+	s.center[1] = cb;
+	s.radius = r;
+	s.angle  = as;
+	s.sweep  = cw ? -sweep : sweep;
+
+	if (!ngc_sim_seg (o, &s, p) ||
+	    !ngc_sim_feed (o, hypot (r * sweep, p[h] - o->pos[h])))
+		return 0;
+
+	memcpy (o->pos, p, sizeof (q));
+	return 1;
+}
+
+static int ngc_sim_carc (struct ngc_device *dev, double *end, double *c, int cw)
+{
+	struct ngc_sim *o = ngc_sim (dev);
+	double p[NGC_AXES];
+	int a, b, h;
+
+	ngc_sim_target (o, 0, end, p);
+	ngc_sim_plane (o, &a, &b, &h);
+
+	return ngc_sim_arc (o, p, o->pos[a] + c[a] * o->scale,
+				  o->pos[b] + c[b] * o->scale, cw);
+}
+
+static int ngc_sim_rarc (struct ngc_device *dev, double *end, double r, int cw)
+{
+	struct ngc_sim *o = ngc_sim (dev);
+	double p[NGC_AXES], da, db, d, h, s;
+	int a, b, z;
+
+	ngc_sim_target (o, 0, end, p);
+	ngc_sim_plane (o, &a, &b, &z);
+
+	da = p[a] - o->pos[a];
+	db = p[b] - o->pos[b];
+	d  = hypot (da, db);
+	r *= o->scale;
+
+	if (d == 0)
+		return ngc_sim_fail (o, "Radius arc end point equals start");
+
+	if ((h = r * r - d * d / 4) < 0)
+		return ngc_sim_fail (o, "Arc radius too small to reach end");
+
+	/* center lies left of the chord for short CCW and long CW arcs */
+	s = (cw ^ (r < 0)) ? -sqrt (h) / d : sqrt (h) / d;
+
+	return ngc_sim_arc (o, p, o->pos[a] + da / 2 - db * s,
+				  o->pos[b] + db / 2 + da * s, cw);
+}
+
+/*
+ * Probe trips at the end point. In asynchronous mode the result is
+ * delivered by waiting poll only, to let the interpreter run ahead.
+ */
+static int ngc_sim_probe (struct ngc_device *dev, double *end)
+{
+	struct ngc_sim *o = ngc_sim (dev);
+	int i;
+
+	if (!ngc_sim_line (dev, 0, end))
+		return 0;
+
+	o->done.op = NGC_OP_PROBE;
+	o->done.ok = 1;
+
+	for (i = 0; i < NGC_AXES; ++i)
+		o->done.pos[i] = o->pos[i] /
+				 (ngc_sim_is_rotary (i) ? 1 : o->scale) -
+				 o->origin[i];
+
+	o->ready = 1;
+	return o->async ? NGC_PENDING : 1;
+}
+
+static int ngc_sim_poll (struct ngc_device *dev, struct ngc_result *r, int wait)
+{
+	struct ngc_sim *o = ngc_sim (dev);
+
+	if (!o->ready || (o->async && !wait))
+		return 0;
+
+	*r = o->done;
+	o->ready = 0;
+	return 1;
+}
+
+static int ngc_sim_dwell (struct ngc_device *dev, double delay)
+{
+	ngc_sim (dev)->stat.time += delay / 60;
+	return 1;
+}
+
+static int ngc_sim_spindle (struct ngc_device *dev, int op, double arg)
+{
+	ngc_sim (dev)->spindle = op == NGC_SPINDLE_CW || op == NGC_SPINDLE_CCW;
+	return 1;
+}
+
+static int ngc_sim_tool (struct ngc_device *dev, int op, int slot)
+{
+	switch (op) {
+	case NGC_TOOL_CHANGE:
+		ngc_sim (dev)->tool = slot;
+		break;
+	case NGC_TOOL_COMP:
+		ngc_sim (dev)->tlo = slot;  /* zero is the current tool */
+		break;
+	}
+
+	return 1;
+}
+
+static int ngc_sim_opt (struct ngc_device *dev, int mask, int on)
+{
+	struct ngc_sim *o = ngc_sim (dev);
+
+	if ((mask & NGC_OPT_RELATIVE) != 0)
+		o->relative = on;
+
+	return 1;
+}
+
+const struct ngc_driver ngc_sim_driver = {
+	.name		= "sim",
+	.alloc		= ngc_sim_alloc,
+	.free		= ngc_sim_free,
+	.block		= ngc_sim_block,
+	.mode		= ngc_sim_mode,
+	.conf		= ngc_sim_conf,
+	.offset		= ngc_sim_offset,
+	.move		= ngc_sim_move,
+	.line		= ngc_sim_line,
+	.carc		= ngc_sim_carc,
+	.rarc		= ngc_sim_rarc,
+	.dwell		= ngc_sim_dwell,
+	.probe		= ngc_sim_probe,
+	.spindle	= ngc_sim_spindle,
+	.tool		= ngc_sim_tool,
+	.opt		= ngc_sim_opt,
+	.poll		= ngc_sim_poll,
+	.save		= ngc_sim_save,
+	.load		= ngc_sim_load,
+};
+
+int ngc_sim_stat (struct ngc_device *o, struct ngc_sim_stat *s)
+{
+	if (o->driver != &ngc_sim_driver)
+		return 0;
+
+	*s = ngc_sim (o)->stat;
+	return 1;
+}
+
+int ngc_sim_limits (struct ngc_device *o, const double *lo, const double *hi)
+{
+	if (o->driver != &ngc_sim_driver)
+		return 0;
+
+	memcpy (ngc_sim (o)->lo, lo, sizeof (ngc_sim (o)->lo));
+	memcpy (ngc_sim (o)->hi, hi, sizeof (ngc_sim (o)->hi));
+	return 1;
+}
+
+size_t ngc_sim_save (struct ngc_device *o, void *buf, size_t size)
+{
+	const size_t len = sizeof (struct ngc_sim);
+	char *p = buf;
+
+	if (o->driver != &ngc_sim_driver)
+		return 0;
+
+	if (buf != NULL && size >= len) {
+		memcpy (p, o, len);
+		memset (p + offsetof (struct ngc_sim, stat.error), 0,
+			sizeof (const char *));
+		memset (p + offsetof (struct ngc_sim, tp), 0,
+			sizeof (struct ngc_toolpath *));
+	}
+
+	return len;
+}
+
+int ngc_sim_load (struct ngc_device *o, const void *buf, size_t size)
+{
+	struct ngc_toolpath *tp;
+
+	if (o->driver != &ngc_sim_driver || size != sizeof (struct ngc_sim))
+		return 0;
+
+	tp = ngc_sim (o)->tp;
+	memcpy (o, buf, size);
+	o->driver = &ngc_sim_driver;
+	ngc_sim (o)->tp = tp;
+	return 1;
+}
+
+int ngc_sim_toolpath (struct ngc_device *o, struct ngc_toolpath *tp)
+{
+	if (o->driver != &ngc_sim_driver)
+		return 0;
+
+	ngc_sim (o)->tp = tp;
+	return 1;
+}
@@ -0,0 +1,52 @@
+/*
+ * NIST RS274/NGC Simulation Device
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_SIM_H
+#define NGC_SIM_H  1
+
+#include <stddef.h>
+
+#include "ngc-device.h"
+
+/*
+ * Simulation statistics: estimated cycle time in minutes and bounding
+ * box of all motions in machine coordinates (millimeters and degrees).
+ */
+struct ngc_sim_stat {
+	double time;
+	double min[NGC_AXES], max[NGC_AXES];
+	unsigned long moves;	/* number of motion commands	*/
+	const char *error;	/* last device error, if any	*/
+};
+
+int ngc_sim_stat (struct ngc_device *o, struct ngc_sim_stat *s);
+
+/*
+ * Set travel (soft) limits in machine coordinates. A motion with any
+ * point of its swept envelope out of limits fails.
+ */
+int ngc_sim_limits (struct ngc_device *o, const double *lo, const double *hi);
+
+/*
+ * Collect swept segments into the path, NULL stops collection. The
+ * tool path is not a part of the saved state.
+ */
+struct ngc_toolpath;
+
+int ngc_sim_toolpath (struct ngc_device *o, struct ngc_toolpath *tp);
+
+/*
+ * Save simulation state into the buffer and load it back. The save
+ * function returns the state size and copies the state only if the
+ * buffer is large enough.
+ */
+size_t ngc_sim_save (struct ngc_device *o, void *buf, size_t size);
+int    ngc_sim_load (struct ngc_device *o, const void *buf, size_t size);
+
+#endif  /* NGC_SIM_H */
@@ -0,0 +1,643 @@
+/*
+ * NIST RS274/NGC Simulation Service
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Clients connect to the local socket and send program file names, one
+ * per line. Every program is checked and executed into the simulation
+ * device by the pool of worker threads, the result is sent back as a
+ * block of diagnostic lines followed by the summary line:
+ *
+ *	<path>:<line>: error: <message>
+ *	<path>: ok|fail time=<sec> min=<x,y,...,w> max=<x,y,...,w>
+ *
+ * Programs are read with the rights of the service, thus the socket is
+ * created accessible to the owner only and connections of other users
+ * (but root) are refused.
+ *
+ * Travel limits could be set per axis in machine coordinates, the first
+ * block leaving them is reported as an error. With -u lengths of inch
+ * programs are normalised to millimeters by the parser, with -a offsets
+ * are applied by the interpreter and the simulator gets end points in
+ * machine coordinates. Results are cached in the
+ * directory given, if any. Compressed programs are streamed through the
+ * decompressor and are not cached.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "ngc-hash.h"
+#include "ngc-input.h"
+#include "ngc-sim.h"
+#include "ngc-state.h"
+
+#define NGC_SIMD_SOCKET	"/run/ngc-simd.sock"
+
+struct conn {
+	int fd;
+	pthread_mutex_t lock;
+	pthread_cond_t idle;
+	unsigned pending;
+};
+
+struct job {
+	struct job *next;
+	struct conn *conn;
+	char *path;
+};
+
+struct pool {
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	struct job *head, **tail;
+};
+
+static struct pool pool = {
+	.lock	= PTHREAD_MUTEX_INITIALIZER,
+	.ready	= PTHREAD_COND_INITIALIZER,
+	.tail	= &pool.head,
+};
+
+static void pool_push (struct job *j)
+{
+	pthread_mutex_lock (&pool.lock);
+
+	j->next = NULL;
+	*pool.tail = j;
+	pool.tail = &j->next;
+
+	pthread_cond_signal (&pool.ready);
+	pthread_mutex_unlock (&pool.lock);
+}
+
+static struct job *pool_pop (void)
+{
+	struct job *j;
+
+	pthread_mutex_lock (&pool.lock);
+
+	while ((j = pool.head) == NULL)
+		pthread_cond_wait (&pool.ready, &pool.lock);
+
+	if ((pool.head = j->next) == NULL)
+		pool.tail = &pool.head;
+
+	pthread_mutex_unlock (&pool.lock);
+	return j;
+}
+
+static double lo[NGC_AXES], hi[NGC_AXES];
+static int metric;		/* normalise lengths to millimeters	*/
+static int machine;		/* simulate in machine coordinates	*/
+
+static int scan_vec (const char *s, double *v)
+{
+	char *p;
+	int i;
+
+	for (i = 0; i < NGC_AXES && *s != '\0'; ++i, s = p + (*p == ',')) {
+		if (*s != ',')
+			v[i] = strtod (s, &p);
+		else
+			p = (char *) s;
+
+		if (*p != ',' && *p != '\0')
+			return 0;
+	}
+
+	return *s == '\0';
+}
+
+static void print_vec (FILE *to, const char *name, const double *v)
+{
+	int i;
+
+	fprintf (to, " %s=", name);
+
+	for (i = 0; i < NGC_AXES; ++i)
+		fprintf (to, i > 0 ? ",%g" : "%g", isfinite (v[i]) ? v[i] : 0);
+}
+
+/*
+ * Program is processed in chunks of lines. The interpreter state after
+ * every chunk is saved into the cache keyed by the hash of the program
+ * prefix, machine configuration and library version. Thus an edited
+ * program is re-run from the first changed chunk only, and an unchanged
+ * one is not run at all. The configuration key mixes in the sizes of the
+ * interpreter state, parameter table and simulator snapshot and the
+ * profile switches, thus a layout change invalidates the cache by itself;
+ * the version is the library one (LIBVER.LIBREV), thus a release with
+ * semantic changes invalidates it as well.
+ */
+#define CHUNK_LINES	4096
+#define CACHE_MAGIC	0x53434e47	/* NGCS */
+#define CACHE_VERSION	"enigma-" NGC_VERSION
+
+static const char *cache;
+static uint64_t config;
+
+struct run {
+	struct ngc_state o;
+	struct ngc_device *dev;
+	FILE *log;
+	char *text;
+	size_t size;
+	int ok, end;
+};
+
+struct snap {
+	unsigned magic;
+	int ok, end;
+	size_t next;			/* offset of the next chunk	*/
+	size_t diag;			/* diagnostics text length	*/
+	struct ngc_state last;		/* last executed block		*/
+};
+
+static void save (struct run *r, uint64_t key, size_t next)
+{
+	const size_t vlen = NGC_VSIZE * sizeof (r->o.var[0]);
+	const size_t slen = ngc_sim_save (r->dev, NULL, 0);
+	struct snap h = {
+		.magic = CACHE_MAGIC, .ok = r->ok, .end = r->end,
+		.next = next, .last = r->o,
+	};
+	char *data;
+
+	fflush (r->log);
+	h.diag = r->size;
+
+	if ((data = malloc (sizeof (h) + vlen + slen + h.diag)) == NULL)
+		return;
+
+	memcpy (data, &h, sizeof (h));
+	memcpy (data + sizeof (h), r->o.var, vlen);
+	ngc_sim_save (r->dev, data + sizeof (h) + vlen, slen);
+	memcpy (data + sizeof (h) + vlen + slen, r->text, h.diag);
+
+	ngc_cache_put (cache, key, data, sizeof (h) + vlen + slen + h.diag);
+	free (data);
+}
+
+static int load (struct run *r, uint64_t key, size_t *next)
+{
+	const size_t vlen = NGC_VSIZE * sizeof (r->o.var[0]);
+	const size_t slen = ngc_sim_save (r->dev, NULL, 0);
+	struct snap h;
+	size_t size;
+	char *data;
+	int ok = 0;
+
+	if ((data = ngc_cache_get (cache, key, &size)) == NULL)
+		return 0;
+
+	if (size < sizeof (h))
+		goto out;
+
+	memcpy (&h, data, sizeof (h));
+
+	if (h.magic != CACHE_MAGIC ||
+	    size != sizeof (h) + vlen + slen + h.diag ||
+	    !ngc_sim_load (r->dev, data + sizeof (h) + vlen, slen))
+		goto out;
+
+	memcpy (r->o.var, data + sizeof (h), vlen);
+	fwrite (data + sizeof (h) + vlen + slen, 1, h.diag, r->log);
+
+	h.last.prev	= NULL;
+	h.last.var	= r->o.var;
+	h.last.ctx	= r->o.ctx;
+	h.last.comment	= NULL;
+
+	r->o   = h.last;
+	r->ok  = h.ok;
+	r->end = h.end;
+	*next  = h.next;
+	ok = 1;
+out:
+	free (data);
+	return ok;
+}
+
+static size_t chunk_end (const char *p, size_t pos, size_t len)
+{
+	const char *q;
+	int i;
+
+	for (i = 0; i < CHUNK_LINES && pos < len; ++i, pos = q - p + 1)
+		if ((q = memchr (p + pos, '\n', len - pos)) == NULL)
+			return len;
+
+	return pos;
+}
+
+static void run_chunks (struct run *r, const char *p, size_t len)
+{
+	size_t count, i, pos, next;
+	uint64_t *key, h = config;
+	struct ngc_sim_stat s;
+	FILE *in;
+
+	for (count = 0, pos = 0; pos < len; pos = chunk_end (p, pos, len))
+		++count;
+
+	if ((key = malloc ((count + 1) * sizeof (key[0]))) == NULL) {
+		r->ok = ngc_error (&r->o, "%s", strerror (errno));
+		return;
+	}
+
+	for (i = 0, pos = 0; i < count; ++i, pos = next) {
+		next = chunk_end (p, pos, len);
+		key[i] = h = ngc_hash (p + pos, next - pos, h);
+	}
+
+	for (i = cache != NULL ? count : 0, pos = 0; i > 0; --i)
+		if (load (r, key[i - 1], &pos))
+			break;
+
+	for (; i < count && r->ok && !r->end; ++i, pos = next) {
+		next = chunk_end (p, pos, len);
+
+		if ((in = fmemopen ((void *) (p + pos), next - pos, "r")) == NULL) {
+			r->ok = ngc_error (&r->o, "%s", strerror (errno));
+			break;
+		}
+
+		r->ok  = ngc_run (&r->o, in, r->dev);
+		r->end = r->o.g[NGC_M4] == NGC_M0020;
+		fclose (in);
+
+		if (!r->ok && ngc_sim_stat (r->dev, &s) && s.error != NULL)
+			ngc_error (&r->o, "%s", s.error);
+
+		if (cache != NULL)
+			save (r, key[i], next);
+	}
+
+	free (key);
+}
+
+static void run_stream (struct run *r, const char *path)
+{
+	struct ngc_sim_stat s;
+	FILE *in;
+
+	if ((in = ngc_input_open (path)) == NULL) {
+		r->ok = ngc_error (&r->o, "%s", strerror (errno));
+		return;
+	}
+
+	r->ok = ngc_run (&r->o, in, r->dev);
+
+	if (!r->ok && ngc_sim_stat (r->dev, &s) && s.error != NULL)
+		ngc_error (&r->o, "%s", s.error);
+
+	if (fclose (in) != 0 && r->ok)
+		r->ok = ngc_error (&r->o, "cannot decompress program");
+}
+
+static int simulate (const char *path, struct run *r)
+{
+	struct stat st;
+	void *p = NULL;
+	int fd;
+
+	if (ngc_input_is_packed (path)) {
+		run_stream (r, path);
+		return r->ok;
+	}
+
+	if ((fd = open (path, O_RDONLY | O_CLOEXEC)) == -1 || fstat (fd, &st) != 0)
+		goto no_file;
+
+	if (st.st_size > 0 &&
+	    (p = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0))
+	    == MAP_FAILED)
+		goto no_file;
+
+	run_chunks (r, p, st.st_size);
+
+	if (p != NULL)
+		munmap (p, st.st_size);
+
+	close (fd);
+	return r->ok;
+no_file:
+	if (fd != -1)
+		close (fd);
+
+	return r->ok = ngc_error (&r->o, "%s", strerror (errno));
+}
+
+static int send_all (int fd, const char *p, size_t len)
+{
+	ssize_t n;
+
+	for (; len > 0; p += n, len -= n)
+		if ((n = write (fd, p, len)) == -1) {
+			if (errno != EINTR)
+				return 0;
+
+			n = 0;
+		}
+
+	return 1;
+}
+
+static void report (struct job *j)
+{
+	struct run r = { .ok = 1 };
+	struct ngc_sim_stat s = {};
+	char *out = NULL, *p, *q;
+	size_t size;
+	FILE *to;
+
+	if ((r.o.var = calloc (NGC_VSIZE, sizeof (r.o.var[0]))) == NULL)
+		return;
+
+	if ((r.dev = ngc_device_alloc ("sim")) == NULL)
+		goto no_dev;
+
+	if ((r.log = open_memstream (&r.text, &r.size)) == NULL)
+		goto no_log;
+
+	r.o.ctx.log = r.log;
+
+	if (ngc_sim_limits (r.dev, lo, hi) && ngc_state_reset (&r.o)) {
+		r.o.var[NGC_METRIC]  = metric;
+		r.o.var[NGC_MACHINE] = machine;
+		simulate (j->path, &r);
+	}
+
+	ngc_sim_stat (r.dev, &s);
+	fclose (r.log);
+
+	if ((to = open_memstream (&out, &size)) == NULL)
+		goto no_out;
+
+	for (p = r.text; *p != '\0'; p = q + 1) {
+		if ((q = strchr (p, '\n')) == NULL)
+			break;
+
+		fprintf (to, "%s:%.*s\n", j->path, (int) (q - p), p);
+	}
+
+	fprintf (to, "%s: %s time=%.3f", j->path, r.ok ? "ok" : "fail",
+		 s.time * 60);
+	print_vec (to, "min", s.min);
+	print_vec (to, "max", s.max);
+	fputc ('\n', to);
+	fclose (to);
+
+	pthread_mutex_lock (&j->conn->lock);
+
+	if (!send_all (j->conn->fd, out, size))
+		shutdown (j->conn->fd, SHUT_RDWR);  /* client is gone */
+
+	pthread_mutex_unlock (&j->conn->lock);
+
+	free (out);
+no_out:
+	free (r.text);
+no_log:
+	ngc_device_free (r.dev);
+no_dev:
+	free (r.o.var);
+}
+
+static void *worker (void *cookie)
+{
+	struct job *j;
+	struct conn *c;
+
+	for (;;) {
+		j = pool_pop ();
+		c = j->conn;
+
+		report (j);
+
+		pthread_mutex_lock (&c->lock);
+
+		if (--c->pending == 0)
+			pthread_cond_signal (&c->idle);
+
+		pthread_mutex_unlock (&c->lock);
+
+		free (j->path);
+		free (j);
+	}
+
+	return NULL;
+}
+
+static void *serve (void *cookie)
+{
+	struct conn *c = cookie;
+	FILE *in;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	struct job *j;
+
+	if ((in = fdopen (fcntl (c->fd, F_DUPFD_CLOEXEC, 0), "r")) == NULL)
+		goto no_in;
+
+	while ((len = getline (&line, &size, in)) > 0) {
+		line[strcspn (line, "\r\n")] = '\0';
+
+		if (line[0] == '\0' || (j = malloc (sizeof (*j))) == NULL)
+			continue;
+
+		if ((j->path = strdup (line)) == NULL) {
+			free (j);
+			continue;
+		}
+
+		j->conn = c;
+
+		pthread_mutex_lock (&c->lock);
+		++c->pending;
+		pthread_mutex_unlock (&c->lock);
+
+		pool_push (j);
+	}
+
+	free (line);
+	fclose (in);
+no_in:
+	pthread_mutex_lock (&c->lock);
+
+	while (c->pending > 0)
+		pthread_cond_wait (&c->idle, &c->lock);
+
+	pthread_mutex_unlock (&c->lock);
+
+	close (c->fd);
+	pthread_cond_destroy (&c->idle);
+	pthread_mutex_destroy (&c->lock);
+	free (c);
+	return NULL;
+}
+
+static int listen_on (const char *path)
+{
+	struct sockaddr_un sa = { .sun_family = AF_UNIX };
+	mode_t mask;
+	int s, ok;
+
+	if (strlen (path) >= sizeof (sa.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	strcpy (sa.sun_path, path);
+	unlink (path);
+
+	if ((s = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+		return -1;
+
+	mask = umask (0177);  /* no threads yet */
+	ok = bind (s, (void *) &sa, sizeof (sa)) == 0;
+	umask (mask);
+
+	if (ok && listen (s, 16) == 0)
+		return s;
+
+	close (s);
+	return -1;
+}
+
+/*
+ * Snapshots are raw interpreter state, parameter store and device state,
+ * thus their layout is a part of the cache key besides the version
+ */
+static uint64_t cache_config (void)
+{
+	size_t layout[] = {
+		sizeof (struct ngc_state), NGC_VSIZE, 0,
+		NGC_HAS_G10, NGC_HAS_COMP, NGC_HAS_CYCLES,
+	};
+	struct ngc_device *dev;
+	uint64_t h = ngc_hash (CACHE_VERSION, sizeof (CACHE_VERSION), 0);
+
+	if ((dev = ngc_device_alloc ("sim")) != NULL) {
+		layout[2] = ngc_sim_save (dev, NULL, 0);
+		ngc_device_free (dev);
+	}
+
+	return ngc_hash (layout, sizeof (layout), h);
+}
+
+/*
+ * Accept connections of the service owner and root only
+ */
+static int peer_allowed (int fd)
+{
+	struct ucred cred;
+	socklen_t len = sizeof (cred);
+
+	if (getsockopt (fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+		return 0;
+
+	return cred.uid == 0 || cred.uid == geteuid ();
+}
+
+static int start (void *(*fn) (void *), void *cookie)
+{
+	pthread_t t;
+
+	if (pthread_create (&t, NULL, fn, cookie) != 0)
+		return 0;
+
+	pthread_detach (t);
+	return 1;
+}
+
+int main (int argc, char *argv[])
+{
+	const char *path = NGC_SIMD_SOCKET;
+	long i, count = sysconf (_SC_NPROCESSORS_ONLN);
+	int opt, s, fd;
+	struct conn *c;
+
+	for (i = 0; i < NGC_AXES; ++i) {
+		lo[i] = -INFINITY;
+		hi[i] =  INFINITY;
+	}
+
+	while ((opt = getopt (argc, argv, "c:j:s:m:M:ua")) != -1)
+		switch (opt) {
+		case 'c':	cache = optarg; break;
+		case 'j':	count = atol (optarg); break;
+		case 's':	path  = optarg; break;
+		case 'm':	if (!scan_vec (optarg, lo)) goto usage; break;
+		case 'M':	if (!scan_vec (optarg, hi)) goto usage; break;
+		case 'u':	metric  = 1; break;
+		case 'a':	machine = 1; break;
+		default:	goto usage;
+		}
+
+	config = cache_config ();
+	config = ngc_hash (lo, sizeof (lo), config);
+	config = ngc_hash (hi, sizeof (hi), config);
+	config = ngc_hash (&metric, sizeof (metric), config);
+	config = ngc_hash (&machine, sizeof (machine), config);
+
+	signal (SIGPIPE, SIG_IGN);
+
+	if ((s = listen_on (path)) == -1) {
+		perror ("ngc-simd: listen");
+		return 1;
+	}
+
+	for (i = 0; i < (count > 0 ? count : 1); ++i)
+		if (!start (worker, NULL)) {
+			perror ("ngc-simd: worker");
+			return 1;
+		}
+
+	for (;;) {
+		if ((fd = accept4 (s, NULL, NULL, SOCK_CLOEXEC)) == -1) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+
+			perror ("ngc-simd: accept");
+			return 1;
+		}
+
+		if (!peer_allowed (fd) ||
+		    (c = calloc (1, sizeof (*c))) == NULL) {
+			close (fd);
+			continue;
+		}
+
+		c->fd = fd;
+		pthread_mutex_init (&c->lock, NULL);
+		pthread_cond_init  (&c->idle, NULL);
+
+		if (!start (serve, c)) {
+			close (fd);
+			free (c);
+		}
+	}
+usage:
+	fprintf (stderr, "usage:\n\tngc-simd [-c cache-dir] [-j threads] "
+			 "[-s socket] [-m x,y,...] [-M x,y,...] [-u] [-a]\n");
+	return 1;
+}
@@ -0,0 +1,253 @@
+/*
+ * NIST RS274/NGC State
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "ngc-state.h"
+
+/*
+ * Real-time formatter: appends to the buffer, output is truncated to the
+ * buffer size and always terminated.
+ */
+struct ngc_buf {
+	char *p;
+	size_t size, len;
+};
+
+static void ngc_put_char (struct ngc_buf *b, int c)
+{
+	if (b->len + 1 < b->size)
+		b->p[b->len++] = c;
+
+	b->p[b->len] = '\0';
+}
+
+static void ngc_put_str (struct ngc_buf *b, const char *s)
+{
+	for (s = s != NULL ? s : "(null)"; *s != '\0'; ++s)
+		ngc_put_char (b, *s);
+}
+
+static void ngc_put_ulong (struct ngc_buf *b, unsigned long x, int width)
+{
+	char digit[24];
+	int n = 0;
+
+	do {
+		digit[n++] = '0' + x % 10;
+		x /= 10;
+	}
+	while (x != 0 || n < width);
+
+	while (n > 0)
+		ngc_put_char (b, digit[--n]);
+}
+
+static void ngc_put_long (struct ngc_buf *b, long x)
+{
+	if (x < 0)
+		ngc_put_char (b, '-');
+
+	ngc_put_ulong (b, x < 0 ? -(unsigned long) x : x, 1);
+}
+
+/*
+ * Number m with the decimal point before the last frac digits, trailing
+ * zeros of the fraction removed
+ */
+static void ngc_put_fixed (struct ngc_buf *b, unsigned long m, int frac)
+{
+	unsigned long p = 1, f;
+	int i;
+
+	for (i = 0; i < frac; ++i)
+		p *= 10;
+
+	ngc_put_ulong (b, m / p, 1);
+
+	if ((f = m % p) == 0)
+		return;
+
+	for (; f % 10 == 0; f /= 10)
+		--frac;
+
+	ngc_put_char (b, '.');
+	ngc_put_ulong (b, f, frac);
+}
+
+/*
+ * As %g of printf: six significant digits, exponent form for exponents
+ * below -4 and above 5. The scale is split in two factors to stay
+ * finite for subnormal numbers.
+ */
+static void ngc_put_double (struct ngc_buf *b, double x)
+{
+	unsigned long m;
+	int e, s;
+
+	if (isnan (x)) {
+		ngc_put_str (b, "nan");
+		return;
+	}
+
+	if (x < 0) {
+		ngc_put_char (b, '-');
+		x = -x;
+	}
+
+	if (isinf (x) || x == 0) {
+		ngc_put_str (b, x == 0 ? "0" : "inf");
+		return;
+	}
+
+	e = floor (log10 (x));
+	s = 5 - e;
+	m = x * pow (10, s / 2) * pow (10, s - s / 2) + 0.5;
+
+	if (m >= 1000000)
+		m = (m + 5) / 10, ++e;
+
+	if (e >= -4 && e <= 5) {
+		ngc_put_fixed (b, m, 5 - e);
+		return;
+	}
+
+	ngc_put_fixed (b, m, 5);
+	ngc_put_char (b, 'e');
+	ngc_put_char (b, e < 0 ? '-' : '+');
+	ngc_put_ulong (b, e < 0 ? -e : e, 2);
+}
+
+static void ngc_vformat (struct ngc_buf *b, const char *fmt, va_list ap)
+{
+	for (; *fmt != '\0'; ++fmt) {
+		if (*fmt != '%') {
+			ngc_put_char (b, *fmt);
+			continue;
+		}
+
+		switch (*++fmt) {
+		case 'c':	ngc_put_char   (b, va_arg (ap, int));	 break;
+		case 'd':	ngc_put_long   (b, va_arg (ap, int));	 break;
+		case 'g':	ngc_put_double (b, va_arg (ap, double)); break;
+		case 's':	ngc_put_str    (b, va_arg (ap, char *)); break;
+		case 'l':
+			if (fmt[1] == 'd') {
+				ngc_put_long (b, va_arg (ap, long));
+				++fmt;
+				break;
+			}
+			/* passthrough */
+		default:
+			if (*fmt == '\0')
+				return;
+
+			ngc_put_char (b, *fmt);
+		}
+	}
+}
+
+static void
+ngc_report_rt (struct ngc_state *o, const char *type, const char *fmt,
+	       va_list ap)
+{
+	struct ngc_buf b = { o->ctx.diag, o->ctx.diag_size };
+
+	if (b.size == 0)
+		return;
+
+	b.p[0] = '\0';
+
+	if (o->line > 0) {
+		ngc_put_long (&b, o->line);
+		ngc_put_str  (&b, ": ");
+	}
+
+	ngc_put_str (&b, type);
+	ngc_put_str (&b, ": ");
+	ngc_vformat (&b, fmt, ap);
+}
+
+static void
+ngc_report (struct ngc_state *o, const char *type, const char *fmt, va_list ap)
+{
+	FILE *log = o->ctx.log != NULL ? o->ctx.log : stderr;
+
+	if (o->ctx.diag != NULL) {
+		ngc_report_rt (o, type, fmt, ap);
+		return;
+	}
+
+	if (o->line > 0)
+		fprintf (log, "%ld: ", o->line);
+
+	fprintf  (log, "%s: ", type);
+	vfprintf (log, fmt, ap);
+	fputc ('\n', log);
+}
+
+int ngc_error (struct ngc_state *o, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start (ap, fmt);
+	ngc_report (o, "error", fmt, ap);
+	va_end (ap);
+	return 0;
+}
+
+int ngc_warn (struct ngc_state *o, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start (ap, fmt);
+	ngc_report (o, "warning", fmt, ap);
+	va_end (ap);
+	return 1;
+}
+
+/*
+ * 3.6.1 Initial state after reset (M2, M30) or program start
+ */
+int ngc_state_reset (struct ngc_state *o)
+{
+	int i;
+
+	memset (o->g, 0, sizeof (o->g));
+
+	o->g[NGC_G1]  = NGC_G0010;
+	o->g[NGC_G2]  = NGC_G0170;
+	o->g[NGC_G3]  = NGC_G0900;
+	o->g[NGC_G5]  = NGC_G0940;
+	o->g[NGC_G7]  = NGC_G0400;
+	o->g[NGC_G8]  = NGC_G0490;
+	o->g[NGC_G10] = NGC_G0980;
+	o->g[NGC_G12] = NGC_G0540;
+	o->g[NGC_G13] = NGC_G0640;
+	o->g[NGC_M7]  = NGC_M0050;
+	o->g[NGC_M8]  = NGC_M0090;
+	o->g[NGC_M9]  = NGC_M0480;
+
+	o->var[NGC_OFFSET_ON]	= 0;
+	o->var[NGC_CS]		= 1;
+	o->var[NGC_REL]		= 0;
+	o->var[NGC_INV]		= 0;
+#if NGC_HAS_COMP
+	o->var[NGC_COMP]	= 0;
+#endif
+	o->var[NGC_PLANE]	= NGC_PLANE_XY;
+	o->var[NGC_RETRACT]	= 1;
+
+	for (i = 0; i < NGC_GSIZE; ++i)
+		o->var[NGC_MODAL + i] = o->g[i];
+
+	return 1;
+}
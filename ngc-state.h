@@ -11,32 +11,128 @@
 #define NGC_STATE_H  1
 
 #include <stddef.h>
+#include <stdio.h>
 
 #include "ngc-code.h"
 #include "ngc-device.h"
+#include "ngc-notes.h"
+#include "ngc-queue.h"
+#include "ngc-tools.h"
 #include "ngc-vars.h"
 #include "ngc-word.h"
 
+/*
+ * Block dependencies: classes of parameters read and written by block,
+ * axes of the current point it reads and modal groups it reads and sets
+ */
+enum ngc_var_class {
+	NGC_VC_USER	= 1 << 0,	/* other parameters		*/
+	NGC_VC_PROBE	= 1 << 1,	/* probe results 5061-5070	*/
+	NGC_VC_HOME	= 1 << 2,	/* home positions 5161-5189	*/
+	NGC_VC_ORIGIN	= 1 << 3,	/* offsets, CSs 5210-5390	*/
+	NGC_VC_INPUT	= 1 << 4,	/* input result 5399		*/
+	NGC_VC_TOOL	= 1 << 5,	/* tool data 5400-5413		*/
+	NGC_VC_POS	= 1 << 6,	/* current point		*/
+	NGC_VC_ALL	= (1 << 7) - 1,
+};
+
+struct ngc_deps {
+	unsigned reads, writes;		/* parameter classes		*/
+	long axes;			/* current point axes read	*/
+	unsigned modal_reads, modal_writes;
+};
+
+/*
+ * Context shared by all blocks of a program run: every block state gets
+ * it from the previous one as a whole
+ */
+struct ngc_context {
+	FILE *log;		/* diagnostics, stderr if NULL	*/
+	char *diag;		/* RT mode diagnostics buffer	*/
+	size_t diag_size;
+	struct ngc_tools *tools;	/* tool table, NULL if none	*/
+	struct ngc_queue *queue;	/* injected commands or NULL	*/
+	struct ngc_notes *notes;	/* comment channel or NULL	*/
+};
+
 struct ngc_state {
 	struct ngc_state *prev;
-	double *var;
+	double *var;		/* parameters, shared as well	*/
+	struct ngc_context ctx;
 	const char *comment;
+	int comment_type;	/* see enum ngc_note_type	*/
+	long line;		/* source line number		*/
 
 	int g[NGC_GSIZE];
 	double word[26];
 	long map;		/* explicitly set words */
 
-	double axis[6];
+	double axis[NGC_AXES];
+	double length, time, feed;	/* feed motion, see ngc-feed.h	*/
+	struct ngc_deps deps;
 };
 
+/*
+ * Diagnostics are written into the log. In the real-time mode (the
+ * diagnostics buffer is set) the last message is formatted into the
+ * buffer instead: without stdio, memory allocation and locks. Only %c,
+ * %d, %ld, %s and %g (six significant digits as in printf) formats are
+ * supported then.
+ *
+ * Check and execution of a block (ngc_check, ngc_deps, ngc_exec and
+ * ngc_sync) do not allocate memory and do not take locks in the
+ * real-time mode, thus their worst case time is bounded by the device
+ * and can be measured with the ngc-wcet tool.
+ */
 int ngc_error (struct ngc_state *o, const char *fmt, ...);
 int ngc_warn  (struct ngc_state *o, const char *fmt, ...);
 
 int ngc_state_reset (struct ngc_state *o);
 
+int ngc_parse (struct ngc_state *o, char *line);
+
+/*
+ * Dependency analysis: scan collects parameter references of the line
+ * before it is decoded (without side effects of parameter settings),
+ * deps adds implicit dependencies of the decoded block.
+ */
+unsigned ngc_var_class (int index);
+
+int ngc_scan (struct ngc_state *o, const char *line);
+int ngc_deps (struct ngc_state *o);
 int ngc_check (struct ngc_state *o);
 int ngc_exec  (struct ngc_state *o, struct ngc_device *dev);
 
+int ngc_run (struct ngc_state *o, FILE *in, struct ngc_device *dev);
+
+void ngc_xform (const double *var, double *v);
+
+/*
+ * Pending device operations: the result of the operation is written
+ * into parameters on completion. Sync waits for completions the parsed
+ * block depends on, or for all pending operations if all is set.
+ */
+int ngc_complete (struct ngc_state *o, const struct ngc_result *r);
+int ngc_sync (struct ngc_state *o, struct ngc_device *dev, int all);
+
+/*
+ * Block ring: preallocated block states with previous block links wired
+ * on advance. The depth is the number of blocks kept alive: the current
+ * one plus look-ahead (or history) blocks. Advancing to the next slot
+ * does not allocate or copy the state, parser clears block data itself.
+ */
+struct ngc_ring {
+	struct ngc_state *slot;
+	size_t depth, head;
+};
+
+int  ngc_ring_init  (struct ngc_ring *o, size_t depth,
+		     const struct ngc_state *init);
+void ngc_ring_fini  (struct ngc_ring *o);
+void ngc_ring_reset (struct ngc_ring *o, const struct ngc_state *init);
+
+struct ngc_state *ngc_ring_next (struct ngc_ring *o);
+
 /*
  * NGC State helpers
  */
@@ -47,6 +143,25 @@ static inline int ngc_state_end (struct ngc_state *o)
 	return 1;
 }
 
+/*
+ * Modal state: a block stores only the codes it sets, the current code
+ * of every modal group lives in var and is updated by the executor when
+ * the block is done. Thus the state is materialised without a walk over
+ * previous blocks.
+ */
+static inline int ngc_modal (struct ngc_state *o, int group)
+{
+	return o->g[group] != 0 ? o->g[group] : o->var[NGC_MODAL + group];
+}
+
+static inline void ngc_state_modal (struct ngc_state *o, int *g)
+{
+	int i;
+
+	for (i = 0; i < NGC_GSIZE; ++i)
+		g[i] = ngc_modal (o, i);
+}
+
 static inline int ngc_is_inv_mode (struct ngc_state *o)
 {
 	return o->var[NGC_INV] != 0;
@@ -54,7 +169,20 @@ static inline int ngc_is_inv_mode (struct ngc_state *o)
 
 static inline int ngc_is_comp_mode (struct ngc_state *o)
 {
+#if NGC_HAS_COMP
 	return o->var[NGC_COMP] != 0;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Returns block back steps before the current one, back < depth
+ */
+static inline
+struct ngc_state *ngc_ring_get (struct ngc_ring *o, size_t back)
+{
+	return o->slot + (o->head + o->depth - back) % o->depth;
 }
 
 static inline double ngc_word (struct ngc_state *o, int c)
@@ -0,0 +1,506 @@
+/*
+ * NIST RS274/NGC Stock Material Removal
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ngc-stock.h"
+
+#define NGC_STOCK_TILE	64	/* tile side, cells			*/
+#define NGC_STOCK_CHORDS	4096	/* maximum chords per arc		*/
+#define NGC_STOCK_EPS	1e-3	/* ignored collision depth, mm		*/
+
+struct ngc_stock {
+	double lo[3], hi[3], cell;
+	size_t nx, ny;
+	float *top;			/* material top per cell, row-major */
+
+	struct ngc_hit *hit;
+	size_t count;
+};
+
+struct ngc_stock *ngc_stock_alloc (const double *lo, const double *hi,
+				   double cell)
+{
+	struct ngc_stock *o;
+	size_t i, n;
+
+	if (!(cell > 0) || !(lo[0] < hi[0] && lo[1] < hi[1] && lo[2] < hi[2])) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if ((o = calloc (1, sizeof (*o))) == NULL)
+		return NULL;
+
+	memcpy (o->lo, lo, sizeof (o->lo));
+	memcpy (o->hi, hi, sizeof (o->hi));
+	o->cell = cell;
+	o->nx   = ceil ((hi[0] - lo[0]) / cell);
+	o->ny   = ceil ((hi[1] - lo[1]) / cell);
+	n = o->nx * o->ny;
+
+	if ((o->top = malloc (n * sizeof (o->top[0]))) == NULL) {
+		free (o);
+		return NULL;
+	}
+
+	for (i = 0; i < n; ++i)
+		o->top[i] = hi[2];
+
+	return o;
+}
+
+void ngc_stock_free (struct ngc_stock *o)
+{
+	if (o == NULL)
+		return;
+
+	free (o->hit);
+	free (o->top);
+	free (o);
+}
+
+/*
+ * Tool of the segment: the tip is the segment point less the length
+ * offset
+ */
+struct ngc_tip {
+	double radius, offset[3];
+};
+
+struct ngc_sweep {
+	struct ngc_stock *o;
+	const struct ngc_index *index;
+	const struct ngc_tip *tip;	/* tool per segment		*/
+	double reach;			/* the largest tool radius	*/
+	double lo[3], hi[3];		/* length offset range		*/
+	size_t tiles, tx;		/* total and per row		*/
+};
+
+struct ngc_job {
+	const struct ngc_sweep *w;
+	size_t from, step;		/* tiles of the job		*/
+	size_t i0, i1, j0, j1;		/* cells of the current tile	*/
+
+	size_t *seg;
+	size_t avail;
+
+	struct ngc_hit *hit;
+	size_t count, size;
+	int ok;
+
+	pthread_t tid;
+};
+
+/*
+ * Lower the cells of the tile within the radius from the straight piece
+ * a-b: the segment of the piece within the radius from the cell center
+ * is found from the quadratic equation, and the tool tip is lowest at
+ * one of its ends. Returns the largest depth of the material removed.
+ */
+static double ngc_stock_line (struct ngc_job *j, const double *a,
+			      const double *b, double r)
+{
+	struct ngc_stock *o = j->w->o;
+	const double dx = b[0] - a[0], dy = b[1] - a[1], dz = b[2] - a[2];
+	const double dd = dx * dx + dy * dy;
+	double x0, x1, y0, y1, cx, cy, ex, ey, c, q, d, t0, t1, z, depth = 0;
+	size_t i, i0, i1, k, k0, k1;
+	float *top;
+
+	x0 = floor (((a[0] < b[0] ? a[0] : b[0]) - r - o->lo[0]) / o->cell);
+	x1 = ceil  (((a[0] > b[0] ? a[0] : b[0]) + r - o->lo[0]) / o->cell);
+	y0 = floor (((a[1] < b[1] ? a[1] : b[1]) - r - o->lo[1]) / o->cell);
+	y1 = ceil  (((a[1] > b[1] ? a[1] : b[1]) + r - o->lo[1]) / o->cell);
+
+	if (x1 <= j->i0 || x0 >= j->i1 || y1 <= j->j0 || y0 >= j->j1)
+		return 0;
+
+	i0 = x0 > j->i0 ? x0 : j->i0;
+	i1 = x1 < j->i1 ? x1 : j->i1;
+	k0 = y0 > j->j0 ? y0 : j->j0;
+	k1 = y1 < j->j1 ? y1 : j->j1;
+
+	for (k = k0; k < k1; ++k) {
+		cy  = o->lo[1] + (k + 0.5) * o->cell;
+		ey  = a[1] - cy;
+		top = o->top + k * o->nx;
+
+		for (i = i0; i < i1; ++i) {
+			cx = o->lo[0] + (i + 0.5) * o->cell;
+			ex = a[0] - cx;
+			c  = ex * ex + ey * ey - r * r;
+
+			if (dd == 0) {
+				if (c > 0)
+					continue;
+
+				t0 = 0, t1 = 1;
+			}
+			else {
+				q = dx * ex + dy * ey;
+
+				if ((d = q * q - dd * c) < 0)
+					continue;
+
+				d  = sqrt (d);
+				t0 = (-q - d) / dd;
+				t1 = (-q + d) / dd;
+
+				if (t0 < 0)	t0 = 0;
+				if (t1 > 1)	t1 = 1;
+				if (t0 > t1)	continue;
+			}
+
+			z = a[2] + (dz < 0 ? t1 : t0) * dz;
+
+			if (z < o->lo[2])
+				z = o->lo[2];
+
+			if (z < top[i]) {
+				if (top[i] - z > depth)
+					depth = top[i] - z;
+
+				top[i] = z;
+			}
+		}
+	}
+
+	return depth;
+}
+
+static double ngc_stock_seg (struct ngc_job *j, const struct ngc_seg *s,
+			     double r)
+{
+	const double tol = j->w->o->cell / 4;
+	double a[3], b[3], depth = 0, d, n;
+	size_t i, count = 1;
+
+	if (s->type != NGC_SEG_ARC)
+		return ngc_stock_line (j, s->start, s->end, r);
+
+	if (s->radius > tol) {
+		n = ceil (fabs (s->sweep) / (2 * acos (1 - tol / s->radius)));
+		count = n < 1 ? 1 : n > NGC_STOCK_CHORDS ? NGC_STOCK_CHORDS : n;
+	}
+
+	memcpy (a, s->start, sizeof (a));
+
+	for (i = 1; i <= count; ++i, memcpy (a, b, sizeof (a))) {
+		ngc_seg_point (s, (double) i / count, b);
+
+		if ((d = ngc_stock_line (j, a, b, r)) > depth)
+			depth = d;
+	}
+
+	return depth;
+}
+
+static int ngc_size_cmp (const void *a, const void *b)
+{
+	size_t x = *(const size_t *) a, y = *(const size_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+static int ngc_stock_hit (struct ngc_job *j, size_t i, const struct ngc_seg *s,
+			  double depth)
+{
+	struct ngc_hit *h;
+	size_t size;
+
+	if (j->count == j->size) {
+		size = j->size == 0 ? 64 : j->size * 2;
+
+		if ((h = realloc (j->hit, size * sizeof (h[0]))) == NULL)
+			return 0;
+
+		j->hit  = h;
+		j->size = size;
+	}
+
+	h = j->hit + j->count++;
+	h->seg   = i;
+	h->line  = s->line;
+	h->type  = s->type == NGC_SEG_MOVE ? NGC_HIT_RAPID : NGC_HIT_STOPPED;
+	h->depth = depth;
+	return 1;
+}
+
+/*
+ * Sweep segments crossing the tile in program order: cells of a tile
+ * are touched by this job only
+ */
+static int ngc_stock_tile (struct ngc_job *j, size_t tile)
+{
+	const struct ngc_sweep *w = j->w;
+	struct ngc_stock *o = w->o;
+	const struct ngc_seg *s;
+	const struct ngc_tip *t;
+	struct ngc_seg tip;
+	double lo[3], hi[3], depth;
+	size_t n, i, *seg;
+	int k;
+
+	j->i0 = (tile % w->tx) * NGC_STOCK_TILE;
+	j->j0 = (tile / w->tx) * NGC_STOCK_TILE;
+	j->i1 = j->i0 + NGC_STOCK_TILE < o->nx ? j->i0 + NGC_STOCK_TILE : o->nx;
+	j->j1 = j->j0 + NGC_STOCK_TILE < o->ny ? j->j0 + NGC_STOCK_TILE : o->ny;
+
+	lo[0] = o->lo[0] + j->i0 * o->cell - w->reach + w->lo[0];
+	lo[1] = o->lo[1] + j->j0 * o->cell - w->reach + w->lo[1];
+	lo[2] = -INFINITY;
+	hi[0] = o->lo[0] + j->i1 * o->cell + w->reach + w->hi[0];
+	hi[1] = o->lo[1] + j->j1 * o->cell + w->reach + w->hi[1];
+	hi[2] = o->hi[2] + w->hi[2];
+
+	if ((n = ngc_index_region (w->index, lo, hi, NULL, 0)) > j->avail) {
+		if ((seg = realloc (j->seg, n * sizeof (seg[0]))) == NULL)
+			return 0;
+
+		j->seg   = seg;
+		j->avail = n;
+	}
+
+	ngc_index_region (w->index, lo, hi, j->seg, n);
+	qsort (j->seg, n, sizeof (j->seg[0]), ngc_size_cmp);
+
+	for (i = 0; i < n; ++i) {
+		s = ngc_index_seg (w->index, j->seg[i]);
+		t = w->tip + j->seg[i];
+		tip = *s;
+
+		for (k = 0; k < 3; ++k) {
+			tip.start[k] -= t->offset[k];
+			tip.end[k]   -= t->offset[k];
+		}
+
+		tip.center[0] -= t->offset[s->a];
+		tip.center[1] -= t->offset[s->b];
+
+		depth = ngc_stock_seg (j, &tip, t->radius);
+
+		if (depth > NGC_STOCK_EPS &&
+		    (s->type == NGC_SEG_MOVE || !s->spindle) &&
+		    !ngc_stock_hit (j, j->seg[i], s, depth))
+			return 0;
+	}
+
+	return 1;
+}
+
+static void *ngc_stock_job (void *cookie)
+{
+	struct ngc_job *j = cookie;
+	size_t tile;
+
+	for (tile = j->from; tile < j->w->tiles; tile += j->step)
+		if (!(j->ok = ngc_stock_tile (j, tile)))
+			break;
+
+	return NULL;
+}
+
+static void ngc_stock_spread (struct ngc_job *job, size_t count)
+{
+	size_t i, started;
+
+	for (started = 1; started < count; ++started)
+		if (pthread_create (&job[started].tid, NULL, ngc_stock_job,
+				    job + started) != 0)
+			break;
+
+	for (i = started; i < count; ++i)
+		ngc_stock_job (job + i);
+
+	ngc_stock_job (job);
+
+	for (i = 1; i < started; ++i)
+		pthread_join (job[i].tid, NULL);
+}
+
+static int ngc_hit_cmp (const void *a, const void *b)
+{
+	const struct ngc_hit *x = a, *y = b;
+
+	return (x->seg > y->seg) - (x->seg < y->seg);
+}
+
+/*
+ * Collect collisions of all jobs, a segment crossing several tiles is
+ * reported once with the largest depth
+ */
+static int ngc_stock_merge (struct ngc_stock *o, struct ngc_job *job,
+			    size_t count)
+{
+	struct ngc_hit *h;
+	size_t i, n;
+
+	for (i = 0, n = 0; i < count; ++i)
+		n += job[i].count;
+
+	if ((h = malloc (n * sizeof (h[0]) + 1)) == NULL)
+		return 0;
+
+	for (i = 0, n = 0; i < count; n += job[i].count, ++i)
+		if (job[i].count > 0)
+			memcpy (h + n, job[i].hit,
+				job[i].count * sizeof (h[0]));
+
+	qsort (h, n, sizeof (h[0]), ngc_hit_cmp);
+
+	for (i = 0, o->count = 0; i < n; ++i)
+		if (o->count > 0 && h[o->count - 1].seg == h[i].seg) {
+			if (h[i].depth > h[o->count - 1].depth)
+				h[o->count - 1].depth = h[i].depth;
+		}
+		else
+			h[o->count++] = h[i];
+
+	free (o->hit);
+	o->hit = h;
+	return 1;
+}
+
+static int
+ngc_stock_tool (struct ngc_tools *tools, int slot, struct ngc_tool_data *t)
+{
+	return tools != NULL && ngc_tools_get (tools, slot, t);
+}
+
+/*
+ * Take tool radius and length offset of every segment, and the range of
+ * offsets to look up segments crossing a tile
+ */
+static int ngc_stock_tips (struct ngc_sweep *w, struct ngc_tip *tip,
+			   struct ngc_tools *tools)
+{
+	const size_t n = ngc_index_count (w->index);
+	struct ngc_tool_data t;
+	const struct ngc_seg *s;
+	size_t i;
+	int k;
+
+	for (i = 0; i < n; ++i) {
+		s = ngc_index_seg (w->index, i);
+		tip[i].radius = ngc_stock_tool (tools, s->tool, &t) ?
+				t.diameter / 2 : 0;
+
+		if (tip[i].radius < w->o->cell / 2)
+			tip[i].radius = w->o->cell / 2;
+
+		if (tip[i].radius > w->reach)
+			w->reach = tip[i].radius;
+
+		if (s->tlo <= 0)
+			memset (tip[i].offset, 0, sizeof (tip[i].offset));
+		else if (!ngc_stock_tool (tools, s->tlo, &t)) {
+			errno = ENOENT;
+			return 0;
+		}
+		else
+			memcpy (tip[i].offset, t.offset,
+				sizeof (tip[i].offset));
+
+		for (k = 0; k < 3; ++k) {
+			if (i == 0 || tip[i].offset[k] < w->lo[k])
+				w->lo[k] = tip[i].offset[k];
+
+			if (i == 0 || tip[i].offset[k] > w->hi[k])
+				w->hi[k] = tip[i].offset[k];
+		}
+	}
+
+	return 1;
+}
+
+int ngc_stock_cut (struct ngc_stock *o, const struct ngc_index *index,
+		   struct ngc_tools *tools, int threads)
+{
+	const size_t n = ngc_index_count (index);
+	struct ngc_sweep w = { .o = o, .index = index };
+	struct ngc_job *job;
+	struct ngc_tip *tip;
+	size_t i, count;
+	int ok = 1;
+
+	if ((tip = malloc (n * sizeof (tip[0]) + 1)) == NULL)
+		return 0;
+
+	if (!ngc_stock_tips (&w, tip, tools)) {
+		free (tip);
+		return 0;
+	}
+
+	w.tip    = tip;
+	w.tx     = (o->nx + NGC_STOCK_TILE - 1) / NGC_STOCK_TILE;
+	w.tiles  = w.tx * ((o->ny + NGC_STOCK_TILE - 1) / NGC_STOCK_TILE);
+
+	if (threads <= 0 && (threads = sysconf (_SC_NPROCESSORS_ONLN)) <= 0)
+		threads = 1;
+
+	count = w.tiles < (size_t) threads ? w.tiles : (size_t) threads;
+
+	if ((job = calloc (count, sizeof (job[0]))) == NULL) {
+		free (tip);
+		return 0;
+	}
+
+	for (i = 0; i < count; ++i) {
+		job[i].w    = &w;
+		job[i].from = i;
+		job[i].step = count;
+		job[i].ok   = 1;
+	}
+
+	ngc_stock_spread (job, count);
+
+	for (i = 0; i < count; ++i)
+		ok &= job[i].ok;
+
+	if (ok)
+		ok = ngc_stock_merge (o, job, count);
+
+	for (i = 0; i < count; ++i) {
+		free (job[i].hit);
+		free (job[i].seg);
+	}
+
+	free (job);
+	free (tip);
+
+	if (!ok)
+		errno = ENOMEM;
+
+	return ok;
+}
+
+const struct ngc_hit *ngc_stock_hits (const struct ngc_stock *o,
+				      size_t *count)
+{
+	*count = o->count;
+	return o->hit;
+}
+
+double ngc_stock_removed (const struct ngc_stock *o)
+{
+	const size_t n = o->nx * o->ny;
+	double sum = 0;
+	size_t i;
+
+	for (i = 0; i < n; ++i)
+		sum += o->hi[2] - o->top[i];
+
+	return sum * o->cell * o->cell;
+}
@@ -0,0 +1,67 @@
+/*
+ * NIST RS274/NGC Stock Material Removal
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_STOCK_H
+#define NGC_STOCK_H  1
+
+#include <stddef.h>
+
+#include "ngc-index.h"
+#include "ngc-tools.h"
+
+/*
+ * Stock is a box lo-hi in machine coordinates, millimeters, modelled by
+ * Z-dexels: a grid of square cells of the given size in the XY plane,
+ * each cell keeps the top of the material above it.
+ *
+ * Cut sweeps tool path segments through the stock. The tool is a flat
+ * end mill of the diameter found in the tool table for the tool slot of
+ * the segment, tools missing from the table (or no table) remove a
+ * single cell wide track. The tool tip is the segment point less the
+ * length offset active for the segment, taken from the tool table as
+ * well: cut fails with ENOENT if the tool is missing. Arcs are split
+ * into chords within a quarter of the cell from the arc. The grid is
+ * split into tiles, tiles are spread over threads (zero means the number
+ * of online processors) and every tile takes the segments crossing it
+ * from the index in program order, thus the result does not depend on
+ * the number of threads.
+ */
+struct ngc_stock *ngc_stock_alloc (const double *lo, const double *hi,
+				   double cell);
+void ngc_stock_free (struct ngc_stock *o);
+
+int ngc_stock_cut (struct ngc_stock *o, const struct ngc_index *index,
+		   struct ngc_tools *tools, int threads);
+
+/*
+ * Rapid motions and motions with the spindle stopped must not remove
+ * any material. Collisions are ordered by segment, one per segment, the
+ * depth is the largest thickness of material removed in a cell.
+ */
+enum ngc_hit_type {
+	NGC_HIT_RAPID,		/* rapid motion into the material	*/
+	NGC_HIT_STOPPED,	/* feed motion with the spindle stopped	*/
+};
+
+struct ngc_hit {
+	size_t seg;		/* segment number in the index		*/
+	long line;		/* block line number			*/
+	int type;
+	double depth;
+};
+
+const struct ngc_hit *ngc_stock_hits (const struct ngc_stock *o,
+				      size_t *count);
+
+/*
+ * Volume of the material removed, cubic millimeters
+ */
+double ngc_stock_removed (const struct ngc_stock *o);
+
+#endif  /* NGC_STOCK_H */
@@ -0,0 +1,141 @@
+/*
+ * NIST RS274/NGC Machine Event Timeline
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ngc-events.h"
+#include "ngc-state.h"
+
+#define NGC_TIMELINE_RAPID	10000	/* default traverse rate, mm/min */
+
+static void show (const char *program, const struct ngc_event *e)
+{
+	static const char *spindle[] = {
+		[NGC_SPINDLE_STOP]	= "stop",
+		[NGC_SPINDLE_CW]	= "cw",
+		[NGC_SPINDLE_CCW]	= "ccw",
+		[NGC_SPINDLE_ORIENT]	= "orient",
+	};
+
+	printf ("%s\t%ld\t%.3f\t", program, e->line, e->time);
+
+	switch (e->type) {
+	case NGC_EVENT_TOOL:
+		printf ("tool %s %g\n", e->op == NGC_TOOL_SELECT ? "select" :
+					"change", e->arg);
+		break;
+	case NGC_EVENT_SPINDLE:
+		printf ("spindle %s %g\n", spindle[e->op], e->arg);
+		break;
+	case NGC_EVENT_COOLANT:
+		printf ("coolant%s%s%s%s\n",
+			e->op == 0 ? " off" : "",
+			(e->op & NGC_COOLANT_FLOOD) != 0 ? " flood" : "",
+			(e->op & NGC_COOLANT_MIST)  != 0 ? " mist"  : "",
+			(e->op & NGC_COOLANT_TROUGH_TOOL) != 0 ?
+			" through-tool" : "");
+		break;
+	case NGC_EVENT_STOP:
+		printf (e->op ? "stop optional\n" : "stop\n");
+		break;
+	case NGC_EVENT_PALLET:
+		printf ("pallet shuttle\n");
+		break;
+	case NGC_EVENT_END:
+		printf ("end\n");
+		break;
+	}
+}
+
+static int timeline (const char *program, struct ngc_tools *tools,
+		     double rapid)
+{
+	struct ngc_state o = {};
+	struct ngc_device *dev;
+	struct ngc_timeline t;
+	FILE *in;
+	size_t i;
+	int ok;
+
+	if ((in = fopen (program, "r")) == NULL) {
+		perror (program);
+		return 0;
+	}
+
+	if ((o.var = calloc (NGC_VSIZE, sizeof (o.var[0]))) == NULL ||
+	    (dev = ngc_device_alloc ("events")) == NULL) {
+		perror ("ngc-timeline");
+		free (o.var);
+		fclose (in);
+		return 0;
+	}
+
+	ngc_state_reset (&o);
+	o.ctx.tools = tools;
+	o.var[NGC_NO_COMMENTS] = 1;
+	o.var[NGC_NO_MOTION]   = 1;
+	o.var[NGC_RAPID]       = rapid;
+
+	if ((ok = ngc_run (&o, in, dev))) {
+		ngc_events_timeline (dev, &t);
+
+		for (i = 0; i < t.count; ++i)
+			show (program, t.event + i);
+
+		printf ("%s\t-\t%.3f\ttotal\n", program, t.time);
+	}
+
+	ngc_device_free (dev);
+	free (o.var);
+	fclose (in);
+	return ok;
+}
+
+int main (int argc, char *argv[])
+{
+	const char *table = NULL;
+	struct ngc_tools *tools = NULL;
+	double rapid = NGC_TIMELINE_RAPID;
+	int opt, i, ok = 1;
+
+	while ((opt = getopt (argc, argv, "r:t:")) != -1)
+		switch (opt) {
+		case 'r':
+			rapid = atof (optarg);
+			break;
+		case 't':
+			table = optarg;
+			break;
+		default:
+			goto usage;
+		}
+
+	if (optind == argc)
+		goto usage;
+
+	if (table != NULL &&
+	    ((tools = ngc_tools_alloc ()) == NULL ||
+	     !ngc_tools_load (tools, table))) {
+		perror ("ngc-timeline: cannot load tool table");
+		ngc_tools_free (tools);
+		return 1;
+	}
+
+	for (i = optind; i < argc; ++i)
+		ok &= timeline (argv[i], tools, rapid);
+
+	ngc_tools_free (tools);
+	return ok ? 0 : 1;
+usage:
+	fprintf (stderr, "usage:\n\tngc-timeline [-r rapid-rate] "
+			 "[-t tool-table] program.ngc...\n");
+	return 1;
+}
@@ -0,0 +1,202 @@
+/*
+ * NIST RS274/NGC Tool Path
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "ngc-toolpath.h"
+
+static double ngc_norm_angle (double x)
+{
+	x = fmod (x, 2 * M_PI);
+	return x < 0 ? x + 2 * M_PI : x;
+}
+
+void ngc_seg_point (const struct ngc_seg *s, double t, double *p)
+{
+	const int h = 3 - s->a - s->b;
+	double u;
+	int i;
+
+	if (s->type != NGC_SEG_ARC) {
+		for (i = 0; i < 3; ++i)
+			p[i] = s->start[i] + (s->end[i] - s->start[i]) * t;
+
+		return;
+	}
+
+	u = s->angle + s->sweep * t;
+
+	p[s->a] = s->center[0] + s->radius * cos (u);
+	p[s->b] = s->center[1] + s->radius * sin (u);
+	p[h]    = s->start[h] + (s->end[h] - s->start[h]) * t;
+}
+
+static double ngc_dist (const double *a, const double *b)
+{
+	return sqrt ((a[0] - b[0]) * (a[0] - b[0]) +
+		     (a[1] - b[1]) * (a[1] - b[1]) +
+		     (a[2] - b[2]) * (a[2] - b[2]));
+}
+
+static double ngc_seg_dist_at (const struct ngc_seg *s, double t,
+			       const double *p)
+{
+	double q[3];
+
+	ngc_seg_point (s, t, q);
+	return ngc_dist (p, q);
+}
+
+/*
+ * Along a helix the squared distance is a periodic term of the angle,
+ * convex within a quarter turn of the angle of the point, plus a convex
+ * term of the height. Thus the helix is sampled every eighth of a turn
+ * and the nearest sample is refined by golden section search between
+ * its neighbours.
+ */
+#define NGC_HELIX_STEPS	64	/* golden section steps, 0.618^64 < 1e-13 */
+
+static double ngc_helix_param (const struct ngc_seg *s, const double *p)
+{
+	const double g = (sqrt (5) - 1) / 2;
+	const int n = ceil (fabs (s->sweep) / M_PI_4);
+	double best = INFINITY, d, lo, hi, x, y, fx, fy;
+	int i, k = 0;
+
+	for (i = 0; i <= n; ++i)
+		if ((d = ngc_seg_dist_at (s, (double) i / n, p)) < best) {
+			best = d;
+			k = i;
+		}
+
+	lo = k > 0 ? (k - 1.0) / n : 0;
+	hi = k < n ? (k + 1.0) / n : 1;
+	x  = hi - g * (hi - lo), fx = ngc_seg_dist_at (s, x, p);
+	y  = lo + g * (hi - lo), fy = ngc_seg_dist_at (s, y, p);
+
+	for (i = 0; i < NGC_HELIX_STEPS; ++i)
+		if (fx < fy) {
+			hi = y, y = x, fy = fx;
+			x  = hi - g * (hi - lo), fx = ngc_seg_dist_at (s, x, p);
+		}
+		else {
+			lo = x, x = y, fx = fy;
+			y  = lo + g * (hi - lo), fy = ngc_seg_dist_at (s, y, p);
+		}
+
+	return ngc_seg_dist_at (s, (lo + hi) / 2, p) < best ?
+	       (lo + hi) / 2 : (double) k / n;
+}
+
+/*
+ * The distance to a point of a circle grows with the angle between the
+ * point and the given one, thus outside of the sweep the nearest point
+ * is the nearest by angle end point
+ */
+static double ngc_seg_param (const struct ngc_seg *s, const double *p)
+{
+	const int h = 3 - s->a - s->b;
+	const double w = fabs (s->sweep);
+	double d, l = 0;
+	int i;
+
+	if (s->type == NGC_SEG_ARC) {
+		if (w == 0)
+			return 0;
+
+		if (s->start[h] != s->end[h])
+			return ngc_helix_param (s, p);
+
+		d = atan2 (p[s->b] - s->center[1], p[s->a] - s->center[0]);
+		d = ngc_norm_angle (s->sweep > 0 ? d - s->angle : s->angle - d);
+
+		return d <= w ? d / w : d - w < 2 * M_PI - d ? 1 : 0;
+	}
+
+	for (i = 0, d = 0; i < 3; ++i) {
+		d += (p[i] - s->start[i]) * (s->end[i] - s->start[i]);
+		l += (s->end[i] - s->start[i]) * (s->end[i] - s->start[i]);
+	}
+
+	return l == 0 || d <= 0 ? 0 : d >= l ? 1 : d / l;
+}
+
+double ngc_seg_dist (const struct ngc_seg *s, const double *p)
+{
+	return ngc_seg_dist_at (s, ngc_seg_param (s, p), p);
+}
+
+static void ngc_seg_add_point (struct ngc_seg *s, const double *p)
+{
+	int i;
+
+	for (i = 0; i < 3; ++i) {
+		if (p[i] < s->lo[i])	s->lo[i] = p[i];
+		if (p[i] > s->hi[i])	s->hi[i] = p[i];
+	}
+}
+
+/*
+ * Arc box also needs the quadrant points passed by the arc, the helix
+ * axis range is spanned by the end points
+ */
+static void ngc_seg_bound (struct ngc_seg *s)
+{
+	double d, q[3];
+	int i, k;
+
+	for (i = 0; i < 3; ++i) {
+		s->lo[i] = fmin (s->start[i], s->end[i]);
+		s->hi[i] = fmax (s->start[i], s->end[i]);
+	}
+
+	if (s->type != NGC_SEG_ARC)
+		return;
+
+	for (k = 0; k < 4; ++k) {
+		d = ngc_norm_angle (s->sweep > 0 ? k * M_PI_2 - s->angle :
+						   s->angle - k * M_PI_2);
+		if (d > fabs (s->sweep))
+			continue;
+
+		q[3 - s->a - s->b] = s->start[3 - s->a - s->b];
+		q[s->a] = s->center[0] + s->radius * cos (k * M_PI_2);
+		q[s->b] = s->center[1] + s->radius * sin (k * M_PI_2);
+		ngc_seg_add_point (s, q);
+	}
+}
+
+int ngc_toolpath_add (struct ngc_toolpath *o, const struct ngc_seg *s)
+{
+	struct ngc_seg *seg;
+	size_t avail;
+
+	if (o->count == o->avail) {
+		avail = o->avail == 0 ? 1024 : o->avail * 2;
+
+		if ((seg = realloc (o->seg, avail * sizeof (seg[0]))) == NULL)
+			return 0;
+
+		o->seg   = seg;
+		o->avail = avail;
+	}
+
+	seg = o->seg + o->count++;
+	*seg = *s;
+	ngc_seg_bound (seg);
+	return 1;
+}
+
+void ngc_toolpath_fini (struct ngc_toolpath *o)
+{
+	free (o->seg);
+	o->seg = NULL;
+	o->count = o->avail = 0;
+}
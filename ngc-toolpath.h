@@ -0,0 +1,63 @@
+/*
+ * NIST RS274/NGC Tool Path
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_TOOLPATH_H
+#define NGC_TOOLPATH_H  1
+
+#include <stddef.h>
+
+/*
+ * Swept segments of the spindle gauge point in machine coordinates,
+ * millimeters: the tool tip is shifted from it by the length offset of
+ * the tool tlo if the offset is active. Only linear X, Y and Z axes are
+ * kept. An arc lies in the plane of axes a and b (indices 0 to 2)
+ * around the center, starts at the angle and turns by the sweep
+ * (positive is counterclockwise), the third axis moves linearly along
+ * the arc (helix).
+ */
+enum ngc_seg_type {
+	NGC_SEG_MOVE,		/* rapid motion			*/
+	NGC_SEG_LINE,		/* straight feed motion		*/
+	NGC_SEG_ARC,		/* circular feed motion		*/
+};
+
+struct ngc_seg {
+	long line;			/* block line number		*/
+	int type;
+	int tool, spindle;		/* tool slot, spindle is running */
+	int tlo;			/* length offset tool slot or -1 */
+	int a, b;			/* arc plane axes		*/
+	double start[3], end[3];
+	double center[2], radius;	/* arc center in the plane	*/
+	double angle, sweep;
+	double lo[3], hi[3];		/* bounding box			*/
+};
+
+/*
+ * Point of the segment at parameter t from 0 (start) to 1 (end), and
+ * distance from the point to the segment (exact for straight segments
+ * and plane arcs, found by numeric search to within 1e-9 of the helix
+ * length for helices)
+ */
+void   ngc_seg_point (const struct ngc_seg *s, double t, double *p);
+double ngc_seg_dist  (const struct ngc_seg *s, const double *p);
+
+/*
+ * Growable path, the add function computes the bounding box of the
+ * segment
+ */
+struct ngc_toolpath {
+	struct ngc_seg *seg;
+	size_t count, avail;
+};
+
+int  ngc_toolpath_add  (struct ngc_toolpath *o, const struct ngc_seg *s);
+void ngc_toolpath_fini (struct ngc_toolpath *o);
+
+#endif  /* NGC_TOOLPATH_H */
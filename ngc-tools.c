@@ -0,0 +1,247 @@
+/*
+ * NIST RS274/NGC Tool Table
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ngc-tools.h"
+#include "ngc-vars.h"
+
+struct ngc_tool_set {
+	struct ngc_tool_set *next;	/* retired sets			*/
+	size_t count;
+	struct ngc_tool_data tool[];	/* number < 0 for empty entry	*/
+};
+
+struct ngc_tools {
+	_Atomic (struct ngc_tool_set *) cur;
+	atomic_size_t readers;		/* readers inside get		*/
+	struct ngc_tool_set *retired;
+	pthread_mutex_t lock;		/* serializes loads		*/
+};
+
+struct ngc_tools *ngc_tools_alloc (void)
+{
+	struct ngc_tools *o;
+
+	if ((o = calloc (1, sizeof (*o))) == NULL)
+		return NULL;
+
+	atomic_init (&o->cur, NULL);
+	atomic_init (&o->readers, 0);
+	pthread_mutex_init (&o->lock, NULL);
+	return o;
+}
+
+void ngc_tools_free (struct ngc_tools *o)
+{
+	struct ngc_tool_set *s, *next;
+
+	if (o == NULL)
+		return;
+
+	for (s = o->retired; s != NULL; s = next) {
+		next = s->next;
+		free (s);
+	}
+
+	free (atomic_load (&o->cur));
+	pthread_mutex_destroy (&o->lock);
+	free (o);
+}
+
+static int ngc_tool_parse (char *line, struct ngc_tool_data *t)
+{
+	static const char axes[] = "XYZABCUVW";
+	char *p = line, *end;
+	int c, axis, words = 0;
+	double v;
+
+	memset (t, 0, sizeof (*t));
+	t->number = -1;
+
+	for (;;) {
+		while (isspace ((unsigned char) *p))
+			++p;
+
+		if (*p == '\0' || *p == ';' || *p == '(')
+			break;
+
+		c = toupper ((unsigned char) *p++);
+		v = strtod (p, &end);
+
+		if (end == p)
+			return 0;
+
+		p = end;
+		++words;
+
+		switch (c) {
+		case 'T':
+			if (v < 0 || v >= NGC_TOOL_LIMIT)
+				return 0;
+
+			t->number = v;
+			break;
+
+		case 'P':	t->pocket      = v; break;
+		case 'D':	t->diameter    = v; break;
+		case 'I':	t->front       = v; break;
+		case 'J':	t->back        = v; break;
+		case 'Q':	t->orientation = v; break;
+		default:
+			if ((end = strchr (axes, c)) == NULL)
+				return 0;
+
+			axis = end - axes;
+			t->offset[axis] = v;
+		}
+	}
+
+	return words == 0 || t->number >= 0;  /* tool number required */
+}
+
+static struct ngc_tool_set *ngc_tool_read (FILE *f)
+{
+	struct ngc_tool_data *list = NULL, *l, t;
+	struct ngc_tool_set *s = NULL;
+	size_t count = 0, avail = 0, size = 0, i;
+	char *line = NULL;
+	int max = -1;
+
+	while (getline (&line, &size, f) > 0) {
+		if (!ngc_tool_parse (line, &t)) {
+			errno = EINVAL;
+			goto out;
+		}
+
+		if (t.number < 0)
+			continue;  /* empty line or comment */
+
+		if (count == avail) {
+			avail = avail == 0 ? 64 : avail * 2;
+
+			if ((l = realloc (list, avail * sizeof (*l))) == NULL)
+				goto out;
+
+			list = l;
+		}
+
+		list[count++] = t;
+
+		if (t.number > max)
+			max = t.number;
+	}
+
+	if (ferror (f))
+		goto out;
+
+	s = malloc (sizeof (*s) + (max + 1) * sizeof (s->tool[0]));
+
+	if (s == NULL)
+		goto out;
+
+	s->next  = NULL;
+	s->count = max + 1;
+
+	for (i = 0; i < s->count; ++i)
+		s->tool[i].number = -1;
+
+	for (i = 0; i < count; ++i)
+		s->tool[list[i].number] = list[i];
+out:
+	free (line);
+	free (list);
+	return s;
+}
+
+/*
+ * Free retired tables if no reader is inside get: a reader entering get
+ * after the check loads the current table only, as readers count is
+ * raised before the table pointer is loaded. Otherwise retired tables
+ * are kept until the next load or free.
+ */
+static void ngc_tools_reclaim (struct ngc_tools *o)
+{
+	struct ngc_tool_set *s, *next;
+
+	if (atomic_load (&o->readers) != 0)
+		return;
+
+	for (s = o->retired, o->retired = NULL; s != NULL; s = next) {
+		next = s->next;
+		free (s);
+	}
+}
+
+int ngc_tools_load (struct ngc_tools *o, const char *path)
+{
+	struct ngc_tool_set *s, *prev;
+	FILE *f;
+
+	if ((f = fopen (path, "r")) == NULL)
+		return 0;
+
+	s = ngc_tool_read (f);
+	fclose (f);
+
+	if (s == NULL)
+		return 0;
+
+	pthread_mutex_lock (&o->lock);
+
+	prev = atomic_exchange (&o->cur, s);
+
+	if (prev != NULL) {
+		prev->next = o->retired;
+		o->retired = prev;
+	}
+
+	ngc_tools_reclaim (o);
+	pthread_mutex_unlock (&o->lock);
+	return 1;
+}
+
+int ngc_tools_get (struct ngc_tools *o, int number, struct ngc_tool_data *t)
+{
+	struct ngc_tool_set *s;
+	int ok;
+
+	atomic_fetch_add (&o->readers, 1);
+	s = atomic_load (&o->cur);
+
+	ok = s != NULL && number >= 0 && (size_t) number < s->count &&
+	     s->tool[number].number >= 0;
+
+	if (ok)
+		*t = s->tool[number];
+
+	atomic_fetch_sub (&o->readers, 1);
+	return ok;
+}
+
+void ngc_tool_vars (const struct ngc_tool_data *t, double *v)
+{
+	int i;
+
+	v[NGC_TOOL - NGC_TOOL] = t->number;
+
+	for (i = 0; i < NGC_AXES; ++i)
+		v[NGC_TOOL_X - NGC_TOOL + i] = t->offset[i];
+
+	v[NGC_TOOL_D  - NGC_TOOL] = t->diameter;
+	v[NGC_TOOL_FA - NGC_TOOL] = t->front;
+	v[NGC_TOOL_BA - NGC_TOOL] = t->back;
+	v[NGC_TOOL_O  - NGC_TOOL] = t->orientation;
+}
@@ -0,0 +1,53 @@
+/*
+ * NIST RS274/NGC Tool Table
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef NGC_TOOLS_H
+#define NGC_TOOLS_H  1
+
+#include "ngc-device.h"
+
+#define NGC_TOOL_LIMIT	10000	/* tool numbers are less than limit	*/
+
+struct ngc_tool_data {
+	int number, pocket;
+	double offset[NGC_AXES];	/* length offsets, X to W	*/
+	double diameter;
+	double front, back;		/* front and back angles	*/
+	int orientation;
+};
+
+/*
+ * Tool table: tools are indexed by tool number directly. The table is
+ * loaded from the file in the EMC2 format, one tool per line:
+ *
+ *	T<number> P<pocket> X.. Y.. Z.. A.. B.. C.. U.. V.. W.. D<diameter>
+ *	I<front angle> J<back angle> Q<orientation> ; comment
+ *
+ * Load replaces the table contents atomically: the new table is built
+ * aside and published with a pointer swap, thus readers never block on
+ * (re)load. Loads are serialized. Replaced tables are retired and freed
+ * by a later load (or by free) once no reader is inside get, readers
+ * announce themselves with a counter and copy tool data out.
+ */
+struct ngc_tools *ngc_tools_alloc (void);
+void ngc_tools_free (struct ngc_tools *o);
+
+int ngc_tools_load (struct ngc_tools *o, const char *path);
+
+/*
+ * Copies tool data into t, returns zero if the tool is not in the table
+ */
+int ngc_tools_get (struct ngc_tools *o, int number, struct ngc_tool_data *t);
+
+/*
+ * Fill tool parameters 5400-5413 with tool data, v[0] is parameter 5400
+ */
+void ngc_tool_vars (const struct ngc_tool_data *t, double *v);
+
+#endif  /* NGC_TOOLS_H */
@@ -10,6 +10,9 @@
 #ifndef NGC_VARS_H
 #define NGC_VARS_H  1
 
+#include "ngc-code.h"
+#include "ngc-profile.h"
+
 enum ngc_var {
 	NGC_PROBE_X	= 5061,	/* G38 X			*/
 	NGC_PROBE_Y	= 5062,	/* G38 Y			*/
@@ -177,8 +180,50 @@ enum ngc_var {
 
 	NGC_REL,
 	NGC_INV,
+#if NGC_HAS_COMP
 	NGC_COMP,
+#endif
 	NGC_PLANE,
+	NGC_RETRACT,		/* Retract to initial level	*/
+	NGC_SPEED,		/* Spindle speed		*/
+	NGC_FEED,		/* Feed rate (F)		*/
+#if NGC_HAS_CYCLES
+	NGC_CYCLE_R,		/* Canned cycle R level		*/
+	NGC_CYCLE_Z,		/* Canned cycle bottom level	*/
+#endif
+	NGC_TLO,		/* Tool length offset enabled	*/
+	NGC_MACHINE,		/* Device uses machine coords	*/
+	NGC_METRIC,		/* Lengths normalised to mm	*/
+	NGC_NO_COMMENTS,	/* Plain comments dropped	*/
+	NGC_NO_MOTION,		/* Motions replaced by dwells	*/
+	NGC_RAPID,		/* Traverse rate, mm/min	*/
+	NGC_DIRTY,		/* Origin must be recomposed	*/
+	NGC_WAIT_OPS,		/* Pending device operations	*/
+	NGC_WAIT_AXES,		/* Axes with unknown position	*/
+	NGC_TOOL_NEXT,		/* Selected tool (T)		*/
+
+	NGC_ORIGIN_X,		/* Program origin X: CS + G92 + TLO */
+	NGC_ORIGIN_Y,
+	NGC_ORIGIN_Z,
+	NGC_ORIGIN_A,
+	NGC_ORIGIN_B,
+	NGC_ORIGIN_C,
+	NGC_ORIGIN_U,
+	NGC_ORIGIN_V,
+	NGC_ORIGIN_W,
+
+	NGC_POS_X,		/* Current point in program coords */
+	NGC_POS_Y,
+	NGC_POS_Z,
+	NGC_POS_A,
+	NGC_POS_B,
+	NGC_POS_C,
+	NGC_POS_U,
+	NGC_POS_V,
+	NGC_POS_W,
+
+	NGC_MODAL,		/* Current code of modal groups	*/
+	NGC_MODAL_END = NGC_MODAL + NGC_GSIZE - 1,
 
 	NGC_VSIZE,
 };
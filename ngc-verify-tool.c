@@ -0,0 +1,156 @@
+/*
+ * NIST RS274/NGC Program Verifier
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ngc-sim.h"
+#include "ngc-state.h"
+#include "ngc-stock.h"
+
+#define NGC_VERIFY_CELL		0.25	/* default cell size, mm	*/
+
+static struct ngc_index *trace (const char *program, struct ngc_tools *tools,
+				int threads)
+{
+	struct ngc_toolpath tp = {};
+	struct ngc_state o = {};
+	struct ngc_device *dev;
+	struct ngc_index *index = NULL;
+	FILE *in;
+
+	if ((in = fopen (program, "r")) == NULL) {
+		perror ("ngc-verify: cannot open program");
+		return NULL;
+	}
+
+	if ((o.var = calloc (NGC_VSIZE, sizeof (o.var[0]))) == NULL ||
+	    (dev = ngc_device_alloc ("sim")) == NULL) {
+		perror ("ngc-verify");
+		free (o.var);
+		fclose (in);
+		return NULL;
+	}
+
+	ngc_state_reset (&o);
+	o.ctx.tools = tools;
+	ngc_sim_toolpath (dev, &tp);
+
+	if (!ngc_run (&o, in, dev))
+		;  /* reported by interpreter */
+	else if ((index = ngc_index_build (&tp, threads)) == NULL)
+		perror ("ngc-verify: cannot build index");
+
+	ngc_toolpath_fini (&tp);
+	ngc_device_free (dev);
+	free (o.var);
+	fclose (in);
+	return index;
+}
+
+static int verify (struct ngc_stock *o, struct ngc_index *index,
+		   struct ngc_tools *tools, int threads)
+{
+	static const char *reason[] = {
+		[NGC_HIT_RAPID]		= "rapid motion",
+		[NGC_HIT_STOPPED]	= "spindle is stopped",
+	};
+	const struct ngc_hit *h;
+	size_t count, i;
+
+	if (!ngc_stock_cut (o, index, tools, threads)) {
+		if (errno == ENOENT)
+			fprintf (stderr, "ngc-verify: tool length offset is "
+					 "not in the tool table\n");
+		else
+			perror ("ngc-verify: cannot cut stock");
+
+		return 0;
+	}
+
+	h = ngc_stock_hits (o, &count);
+
+	for (i = 0; i < count; ++i)
+		printf ("%ld: %s cuts %g mm deep\n", h[i].line,
+			reason[h[i].type], h[i].depth);
+
+	printf ("removed %g mm3\n", ngc_stock_removed (o));
+	return count == 0;
+}
+
+static int read_vec (const char *s, double *v, int count)
+{
+	char *end;
+	int i;
+
+	for (i = 0; i < count; ++i, s = end + 1) {
+		v[i] = strtod (s, &end);
+
+		if (end == s || *end != (i + 1 < count ? ',' : '\0'))
+			return 0;
+	}
+
+	return 1;
+}
+
+int main (int argc, char *argv[])
+{
+	const char *table = NULL;
+	struct ngc_tools *tools = NULL;
+	struct ngc_stock *o = NULL;
+	struct ngc_index *index = NULL;
+	double box[6], cell = NGC_VERIFY_CELL;
+	int opt, stock = 0, threads = 0, ok = 0;
+
+	while ((opt = getopt (argc, argv, "c:j:s:t:")) != -1)
+		switch (opt) {
+		case 'c':
+			cell = atof (optarg);
+			break;
+		case 'j':
+			threads = atoi (optarg);
+			break;
+		case 's':
+			if (!(stock = read_vec (optarg, box, 6)))
+				goto usage;
+
+			break;
+		case 't':
+			table = optarg;
+			break;
+		default:
+			goto usage;
+		}
+
+	if (!stock || argc != optind + 1)
+		goto usage;
+
+	if ((o = ngc_stock_alloc (box, box + 3, cell)) == NULL) {
+		perror ("ngc-verify: cannot allocate stock");
+		return 1;
+	}
+
+	if (table != NULL &&
+	    ((tools = ngc_tools_alloc ()) == NULL ||
+	     !ngc_tools_load (tools, table)))
+		perror ("ngc-verify: cannot load tool table");
+	else if ((index = trace (argv[optind], tools, threads)) != NULL)
+		ok = verify (o, index, tools, threads);
+
+	ngc_index_free (index);
+	ngc_tools_free (tools);
+	ngc_stock_free (o);
+	return ok ? 0 : 1;
+usage:
+	fprintf (stderr, "usage:\n\tngc-verify [-j threads] [-t tool-table] "
+			 "[-c cell] -s x0,y0,z0,x1,y1,z1 program.ngc\n");
+	return 1;
+}
@@ -0,0 +1,256 @@
+/*
+ * NIST RS274/NGC Worst Case Execution Time Benchmark
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include "ngc-sim.h"
+#include "ngc-state.h"
+
+/*
+ * Program blocks are parsed outside of the measured region, check and
+ * execution of every block into the simulation device are measured in
+ * the real-time mode. Load threads stream over a buffer larger than
+ * caches to make the measurement pessimistic. Comments are posted into
+ * the comment channel and delivered at stops and at the end of a round.
+ */
+#define LOAD_SIZE	(32 << 20)
+
+static atomic_int stop;
+
+static void *load (void *cookie)
+{
+	char *p;
+	size_t i;
+
+	if ((p = malloc (LOAD_SIZE)) == NULL)
+		return NULL;
+
+	while (!atomic_load_explicit (&stop, memory_order_relaxed))
+		for (i = 0; i < LOAD_SIZE; i += 64)
+			p[i] += i;
+
+	free (p);
+	return NULL;
+}
+
+struct program {
+	char **line;
+	size_t count;
+};
+
+static int read_program (const char *path, struct program *p)
+{
+	FILE *f;
+	char *line = NULL, **l;
+	size_t size = 0, avail = 0;
+	int ok;
+
+	if ((f = fopen (path, "r")) == NULL)
+		return 0;
+
+	while (getline (&line, &size, f) > 0) {
+		if (p->count == avail) {
+			avail = avail == 0 ? 1024 : avail * 2;
+
+			if ((l = realloc (p->line, avail * sizeof (*l))) == NULL)
+				break;
+
+			p->line = l;
+		}
+
+		if ((p->line[p->count] = strdup (line)) == NULL)
+			break;
+
+		++p->count;
+	}
+
+	ok = !ferror (f);
+	free (line);
+	fclose (f);
+	return ok;
+}
+
+static long now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static int cmp (const void *a, const void *b)
+{
+	long x = *(const long *) a, y = *(const long *) b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * A quantile is supported by the sample if at least one sample lies
+ * above it, otherwise it is the maximum in disguise and is not reported
+ */
+static void put_quantile (const char *name, const long *t, size_t n, double q)
+{
+	const size_t need = 1 / (1 - q) + 0.5;
+	size_t i = q * n;
+
+	if (n < need)
+		printf (" %s n/a (%zu blocks needed),", name, need);
+	else
+		printf (" %s %ld,", name, t[i < n ? i : n - 1]);
+}
+
+static int run (struct program *p, struct ngc_state *init,
+		struct ngc_device *dev, long *t, size_t *n)
+{
+	struct ngc_ring r;
+	struct ngc_state *cur;
+	double *var0;
+	char *line;
+	size_t i, size = 0;
+	long t0;
+	int ok = 1;
+
+	if (!ngc_ring_init (&r, 2, init) ||
+	    (var0 = malloc (NGC_VSIZE * sizeof (var0[0]))) == NULL)
+		return 0;
+
+	memcpy (var0, init->var, NGC_VSIZE * sizeof (var0[0]));
+
+	for (i = 0; i < p->count; ++i)
+		if (strlen (p->line[i]) >= size)
+			size = strlen (p->line[i]) + 1;
+
+	if ((line = malloc (size)) == NULL)
+		goto out;
+
+	for (cur = r.slot, i = 0; ok && i < p->count; ++i) {
+		strcpy (line, p->line[i]);
+		cur = ngc_ring_next (&r);
+
+		if (!ngc_parse (cur, line)) {
+			ok = 0;
+			break;
+		}
+
+		t0 = now ();
+		ok = ngc_check (cur) && ngc_deps (cur) && ngc_exec (cur, dev) &&
+		     ngc_sync (cur, dev, 1);
+		t[(*n)++] = now () - t0;
+
+		if (cur->prev == NULL)
+			break;
+	}
+
+	if (!ngc_notes_flush (cur->ctx.notes, dev))
+		ok = 0;
+
+	if (!ok && cur->ctx.diag[0] != '\0')
+		fprintf (stderr, "ngc-wcet: %s\n", cur->ctx.diag);
+	else if (!ok) {
+		struct ngc_sim_stat s;
+
+		ngc_sim_stat (dev, &s);
+		fprintf (stderr, "ngc-wcet: %ld: device error: %s\n",
+			 cur->line, s.error);
+	}
+
+	free (line);
+out:
+	memcpy (init->var, var0, NGC_VSIZE * sizeof (var0[0]));
+	free (var0);
+	ngc_ring_fini (&r);
+	return ok;
+}
+
+int main (int argc, char *argv[])
+{
+	struct program p = {};
+	struct ngc_state o = {};
+	struct ngc_device *dev;
+	struct sched_param sp = { .sched_priority = 80 };
+	char diag[128] = "";
+	long rounds = 100, loads = 0, *t;
+	int opt, rt = 0, quiet = 0, ok = 1, i;
+	pthread_t *tid;
+	size_t n = 0;
+
+	while ((opt = getopt (argc, argv, "n:l:rq")) != -1)
+		switch (opt) {
+		case 'n':	rounds = atol (optarg); break;
+		case 'l':	loads  = atol (optarg); break;
+		case 'r':	rt = 1; break;
+		case 'q':	quiet = 1; break;
+		default:	goto usage;
+		}
+
+	if (argc != optind + 1 || rounds < 1 || loads < 0)
+		goto usage;
+
+	if (!read_program (argv[optind], &p)) {
+		perror ("ngc-wcet: cannot read program");
+		return 1;
+	}
+
+	if ((t = malloc (rounds * p.count * sizeof (t[0]))) == NULL ||
+	    (tid = calloc (loads + 1, sizeof (tid[0]))) == NULL ||
+	    (o.var = calloc (NGC_VSIZE, sizeof (o.var[0]))) == NULL ||
+	    (o.ctx.notes = ngc_notes_alloc ()) == NULL ||
+	    (dev = ngc_device_alloc ("sim")) == NULL) {
+		perror ("ngc-wcet");
+		return 1;
+	}
+
+	o.ctx.diag = diag;
+	o.ctx.diag_size = sizeof (diag);
+	ngc_state_reset (&o);
+	o.var[NGC_NO_COMMENTS] = quiet;
+
+	if (mlockall (MCL_CURRENT | MCL_FUTURE) != 0)
+		perror ("ngc-wcet: warning: cannot lock memory");
+
+	if (rt && sched_setscheduler (0, SCHED_FIFO, &sp) != 0)
+		perror ("ngc-wcet: warning: cannot set real-time policy");
+
+	for (i = 0; i < loads; ++i)
+		pthread_create (tid + i, NULL, load, NULL);
+
+	for (i = 0; ok && i < rounds; ++i)
+		ok = ngc_device_reset (dev) && run (&p, &o, dev, t, &n);
+
+	atomic_store (&stop, 1);
+
+	for (i = 0; i < loads; ++i)
+		pthread_join (tid[i], NULL);
+
+	if (n == 0)
+		return 1;
+
+	qsort (t, n, sizeof (t[0]), cmp);
+
+	printf ("blocks %zu, ns per block:", n);
+	put_quantile ("median",   t, n, 0.5);
+	put_quantile ("p99.9",    t, n, 0.999);
+	put_quantile ("p99.999",  t, n, 0.99999);
+	printf (" max %ld\n", t[n - 1]);
+	return ok ? 0 : 1;
+usage:
+	fprintf (stderr, "usage:\n\tngc-wcet [-n rounds] [-l load-threads] "
+			 "[-r] [-q] program.ngc\n");
+	return 1;
+}
@@ -39,8 +39,9 @@ enum ngc_word {
 	NGC_Z		= 1 << 25,
 
 	NGC_ABC		= NGC_A | NGC_B | NGC_C,
+	NGC_UVW		= NGC_U | NGC_V | NGC_W,
 	NGC_XYZ		= NGC_X | NGC_Y | NGC_Z,
-	NGC_AXIS	= NGC_XYZ | NGC_ABC,
+	NGC_AXIS	= NGC_XYZ | NGC_ABC | NGC_UVW,
 
 	NGC_XY		= NGC_X | NGC_Y,
 	NGC_XZ		= NGC_X | NGC_Z,
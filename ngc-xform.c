@@ -0,0 +1,22 @@
+/*
+ * NIST RS274/NGC Coordinate Transform
+ *
+ * Copyright (c) 2021-2022 Alexei A. Smekalkine
+ *
+ * Standard: NIST IR 6556
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "ngc-state.h"
+
+/*
+ * Convert point from absolute program coordinates to machine ones with
+ * the program origin composed by the executer
+ */
+void ngc_xform (const double *var, double *v)
+{
+	int i;
+
+	for (i = 0; i < NGC_AXES; ++i)
+		v[i] += var[NGC_ORIGIN_X + i];
+}